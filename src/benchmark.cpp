@@ -18,9 +18,12 @@
 
 #include "benchmark.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <vector>
 
 #include "position.h"
@@ -91,8 +94,113 @@ const std::vector<std::string> Defaults = {
   "nqbnrkrb/pppppppp/8/8/8/8/PPPPPPPP/NQBNRKRB w KQkq - 0 1",
   "setoption name UCI_Chess960 value false"
 };
+
+// Suites of the benchsuite command. The middlegame and endgame ones are taken
+// from the bench positions, the TB-heavy one only has positions within or just
+// above the usual 5 to 7-man tablebases (set SyzygyPath before running it), and
+// the experience one runs the middlegame positions with experience enabled.
+const std::vector<std::string> Middlegames = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+  "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+  "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14 moves d4e6",
+  "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14 moves g2g4",
+  "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+  "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+  "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+  "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+  "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+  "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+  "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+  "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+  "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+  "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+  "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+  "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+  "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1"
+};
+
+const std::vector<std::string> Endgames = {
+  "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+  "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+  "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1 moves g5g6 f3e3 g6g5 e3f3",
+  "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+  "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+  "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+  "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+  "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+  "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+  "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+  "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+  "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+  "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+  "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1"
+};
+
+const std::vector<std::string> TablebaseEndgames = {
+  "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+  "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+  "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+  "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+  "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+  "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+  "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+  "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+  "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1",
+  "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+  "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1",
+  "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1"
+};
+
+const std::vector<Hypnos::BenchSuite> Suites = {
+  {"default",    {}, Defaults, {}},
+  {"middlegame", {}, Middlegames, {}},
+  {"endgame",    {}, Endgames, {}},
+  {"tb",         {}, TablebaseEndgames, {}},
+  {"experience", {"setoption name Experience Readonly value true",
+                  "setoption name Experience Enabled value true"}, Middlegames, {}}
+};
 // clang-format on
 
+// Regularized incomplete beta function I_x(a, b), evaluated with its continued
+// fraction (modified Lentz's method)
+double incomplete_beta(double a, double b, double x) {
+
+    if (x <= 0 || x >= 1)
+        return x <= 0 ? 0 : 1;
+
+    // The continued fraction converges quickly for x < (a + 1) / (a + b + 2)
+    if (x > (a + 1) / (a + b + 2))
+        return 1 - incomplete_beta(b, a, 1 - x);
+
+    constexpr double Tiny = 1e-300;
+
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b)
+                            + a * std::log(x) + b * std::log(1 - x))
+                 / a;
+    double f = 1, c = 1, d = 0;
+
+    for (int i = 0; i <= 400; ++i)
+    {
+        int    m = i / 2;
+        double numerator =
+          i == 0       ? 1
+          : i % 2 == 0 ? m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m))
+                       : -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+
+        d = 1 + numerator * d;
+        d = 1 / (std::abs(d) < Tiny ? Tiny : d);
+        c = 1 + numerator / c;
+        c = std::abs(c) < Tiny ? Tiny : c;
+        f *= c * d;
+
+        if (std::abs(1 - c * d) < 1e-12)
+            return front * (f - 1);
+    }
+
+    return front * (f - 1);
+}
+
 }  // namespace
 
 namespace Hypnos {
@@ -162,4 +270,63 @@ std::vector<std::string> setup_bench(const Position& current, std::istream& is)
     return list;
 }
 
+// Returns the suite of the benchsuite command with the given name, or nullptr
+const BenchSuite* bench_suite(const std::string& name) {
+
+    for (const BenchSuite& suite : Suites)
+        if (suite.name == name)
+            return &suite;
+
+    return nullptr;
+}
+
+std::string bench_suite_names() {
+
+    std::string names;
+    for (const BenchSuite& suite : Suites)
+        names += (names.empty() ? "" : ", ") + suite.name;
+
+    return names;
+}
+
+SampleStats sample_stats(std::vector<double> samples) {
+
+    SampleStats s{0, 0, 0, samples.size()};
+
+    if (samples.empty())
+        return s;
+
+    std::sort(samples.begin(), samples.end());
+
+    s.mean   = std::accumulate(samples.begin(), samples.end(), 0.0) / s.n;
+    s.median = s.n % 2 ? samples[s.n / 2] : (samples[s.n / 2 - 1] + samples[s.n / 2]) / 2;
+
+    for (double x : samples)
+        s.stddev += (x - s.mean) * (x - s.mean);
+
+    s.stddev = s.n > 1 ? std::sqrt(s.stddev / (s.n - 1)) : 0;  // Sample standard deviation
+    return s;
+}
+
+// Welch's t-test, which does not assume that both series have the same variance.
+// The p-value is the probability of a difference of the means at least as large
+// as the observed one if both series come from the same distribution.
+double welch_p_value(const SampleStats& a, const SampleStats& b, double* t) {
+
+    double va = a.n > 1 ? a.stddev * a.stddev / a.n : 0;
+    double vb = b.n > 1 ? b.stddev * b.stddev / b.n : 0;
+
+    *t = 0;
+    if (a.n < 2 || b.n < 2 || va + vb == 0)
+        return 1;
+
+    *t = (b.mean - a.mean) / std::sqrt(va + vb);
+
+    // Welch-Satterthwaite degrees of freedom
+    double df = (va + vb) * (va + vb) / (va * va / (a.n - 1) + vb * vb / (b.n - 1));
+
+    // Two-sided tail probability of the Student's t distribution
+    return incomplete_beta(df / 2, 0.5, df / (df + *t * *t));
+}
+
 }  // namespace Hypnos
@@ -19,6 +19,7 @@
 #ifndef BENCHMARK_H_INCLUDED
 #define BENCHMARK_H_INCLUDED
 
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 #include <vector>
@@ -29,6 +30,25 @@ class Position;
 
 std::vector<std::string> setup_bench(const Position&, std::istream&);
 
+// A named list of positions for the benchsuite command, with the UCI commands
+// to run before and after the positions
+struct BenchSuite {
+    std::string              name;
+    std::vector<std::string> setup, fens, teardown;
+};
+
+const BenchSuite* bench_suite(const std::string& name);
+std::string       bench_suite_names();
+
+// Summary statistics of a series of measurements
+struct SampleStats {
+    double mean, stddev, median;
+    size_t n;
+};
+
+SampleStats sample_stats(std::vector<double> samples);
+double      welch_p_value(const SampleStats& a, const SampleStats& b, double* t);
+
 }  // namespace Hypnos
 
 #endif  // #ifndef BENCHMARK_H_INCLUDED
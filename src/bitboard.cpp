@@ -22,6 +22,14 @@
 #include <bitset>
 #include <initializer_list>
 
+#if defined(USE_PEXT)
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
 #include "misc.h"
 
 namespace Hypnos {
@@ -37,6 +45,8 @@ Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
 Magic RookMagics[SQUARE_NB];
 Magic BishopMagics[SQUARE_NB];
 
+SliderBackend Sliders = Bitboards::preferred_sliders();
+
 namespace {
 
 Bitboard RookTable[0x19000];   // To store rook attacks
@@ -84,8 +94,7 @@ void Bitboards::init() {
         for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2)
             SquareDistance[s1][s2] = std::max(distance<File>(s1, s2), distance<Rank>(s1, s2));
 
-    init_magics(ROOK, RookTable, RookMagics);
-    init_magics(BISHOP, BishopTable, BishopMagics);
+    set_sliders(Sliders);
 
     for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
     {
@@ -115,6 +124,62 @@ void Bitboards::init() {
     }
 }
 
+// Returns the slider attacks to use on this CPU. PEXT is microcoded, and much
+// slower than magic bitboards, on AMD and Hygon CPUs older than Zen 3.
+SliderBackend Bitboards::preferred_sliders() {
+
+#if defined(USE_PEXT)
+    auto cpuid = [](unsigned leaf, unsigned regs[4]) {
+    #if defined(_MSC_VER)
+        __cpuid(reinterpret_cast<int*>(regs), int(leaf));
+    #else
+        __get_cpuid(leaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+    #endif
+    };
+
+    unsigned regs[4] = {};
+    cpuid(0, regs);
+
+    // Vendor string in EBX, EDX, ECX: "AuthenticAMD" or "HygonGenuine"
+    const bool amd   = regs[1] == 0x68747541 && regs[3] == 0x69746E65 && regs[2] == 0x444D4163;
+    const bool hygon = regs[1] == 0x6F677948 && regs[3] == 0x6E65476E && regs[2] == 0x656E6975;
+
+    cpuid(1, regs);
+
+    unsigned family = (regs[0] >> 8) & 0xF;
+    if (family == 0xF)
+        family += (regs[0] >> 20) & 0xFF;
+
+    return (amd || hygon) && family < 0x19 ? MagicSliders : PextSliders;
+#else
+    return MagicSliders;
+#endif
+}
+
+
+// Switches the slider attacks and rebuilds their tables. Must only be called
+// while the search threads are idle.
+void Bitboards::set_sliders(SliderBackend b) {
+
+    assert(b == MagicSliders || HasPext);
+
+    Sliders = b;
+    init_magics(ROOK, RookTable, RookMagics);
+    init_magics(BISHOP, BishopTable, BishopMagics);
+}
+
+
+// Describes the slider attacks in use, for compiler_info()
+std::string Bitboards::sliders_info() {
+
+    if (Sliders == PextSliders)
+        return "PEXT";
+
+    return HasPext && preferred_sliders() == MagicSliders
+           ? "magic bitboards (PEXT is slow on this CPU)"
+           : "magic bitboards";
+}
+
 namespace {
 
 Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
@@ -137,9 +202,12 @@ Bitboard sliding_attack(PieceType pt, Square sq, Bitboard occupied) {
 // Computes all rook and bishop attacks at startup. Magic
 // bitboards are used to look up attacks of sliding pieces. As a reference see
 // www.chessprogramming.org/Magic_Bitboards. In particular, here we use the so
-// called "fancy" approach.
+// called "fancy" approach. With PEXT the tables have the same size, but are
+// indexed by the extracted occupancy bits and no magics are needed.
 void init_magics(PieceType pt, Bitboard table[], Magic magics[]) {
 
+    const bool usePext = HasPext && Sliders == PextSliders;
+
     // Optimal PRNG seeds to pick the correct magics in the shortest time
     int seeds[][RANK_NB] = {{8977, 44560, 54343, 38998, 5731, 95205, 104912, 17020},
                             {728, 10316, 55013, 32803, 12281, 15100, 16645, 255}};
@@ -173,14 +241,14 @@ void init_magics(PieceType pt, Bitboard table[], Magic magics[]) {
             occupancy[size] = b;
             reference[size] = sliding_attack(pt, s, b);
 
-            if (HasPext)
+            if (usePext)
                 m.attacks[pext(b, m.mask)] = reference[size];
 
             size++;
             b = (b - m.mask) & m.mask;
         } while (b);
 
-        if (HasPext)
+        if (usePext)
             continue;
 
         PRNG rng(seeds[Is64Bit][rank_of(s)]);
@@ -30,10 +30,23 @@
 
 namespace Hypnos {
 
+// How the attacks of sliding pieces are looked up. PEXT is only available in
+// builds with USE_PEXT, and is not used on CPUs where it is microcoded.
+enum SliderBackend {
+    PextSliders,
+    MagicSliders,
+    SLIDER_BACKEND_NB
+};
+
+extern SliderBackend Sliders;
+
 namespace Bitboards {
 
-void        init();
-std::string pretty(Bitboard b);
+void          init();
+std::string   pretty(Bitboard b);
+SliderBackend preferred_sliders();
+void          set_sliders(SliderBackend b);
+std::string   sliders_info();
 
 }  // namespace Hypnos::Bitboards
 
@@ -74,7 +87,7 @@ struct Magic {
     // Compute the attack's index using the 'magic bitboards' approach
     unsigned index(Bitboard occupied) const {
 
-        if (HasPext)
+        if (HasPext && Sliders == PextSliders)
             return unsigned(pext(occupied, mask));
 
         if (Is64Bit)
@@ -2,12 +2,12 @@
 #include "../uci.h"
 #include "polyglot/polyglot.h"
 #include "ctg/ctg.h"
+#include "compiled/compiled.h"
 #include "book.h"
 
 using namespace std;
 
 namespace Hypnos::Book {
-namespace {
 Book* create_book(const string& filename) {
     size_t extIndex = filename.find_last_of('.');
     if (extIndex == string::npos)
@@ -19,13 +19,18 @@ Book* create_book(const string& filename) {
         return new CTG::CtgBook();
     else if (ext == "bin")
         return new Polyglot::PolyglotBook();
+    else if (ext == "hbk")
+        return new Compiled::CompiledBook();
     else
         return nullptr;
 }
-}
 
 Book* book;
 
+void Book::benchmark(size_t /*probes*/) const {
+    sync_cout << "info string Benchmark not supported for " << type() << " books" << sync_endl;
+}
+
 void init() {
     book = nullptr;
 
@@ -61,15 +66,23 @@ void on_book(const string& filename) {
 }
 
 Move probe(const Position& pos) {
-    int  moveNumber = 1 + pos.game_ply() / 2;
-    Move bookMove   = Move::none();
+    const auto opts       = UCI::snapshot();
+    int        moveNumber = 1 + pos.game_ply() / 2;
+    Move       bookMove   = Move::none();
 
-    if (book != nullptr && (int) Options["Book Depth"] >= moveNumber)
-        bookMove = book->probe(pos, (size_t) (int) Options["Book Width"], true);
+    if (book != nullptr && opts->bookDepth >= moveNumber)
+        bookMove = book->probe(pos, (size_t) opts->bookWidth, true);
 
     return bookMove;
 }
 
+void benchmark(size_t probes) {
+    if (book == nullptr)
+        sync_cout << "info string No book loaded" << sync_endl;
+    else
+        book->benchmark(probes);
+}
+
 void show_moves(const Position& pos) {
     cout << pos << endl << endl;
 
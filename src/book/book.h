@@ -1,7 +1,11 @@
 #ifndef BOOK_H_INCLUDED
 #define BOOK_H_INCLUDED
 
+#include <cstdint>
+#include <istream>
 #include <string>
+#include <utility>
+#include <vector>
 #include "../types.h"
 #include "../position.h"
 
@@ -65,13 +69,25 @@ class Book {
 
     virtual Move probe(const Position& pos, size_t width, bool onlyGreen) const = 0;
     virtual void show_moves(const Position& pos) const                          = 0;
+
+    // Appends the playable moves of the position with a non-negative weight,
+    // used by the book compiler to merge several books
+    virtual void get_weighted_moves(const Position&                        pos,
+                                    std::vector<std::pair<Move, int64_t>>& moves) const = 0;
+
+    // Measures the probe rate of the book, for books which support it
+    virtual void benchmark(size_t probes) const;
 };
 
+Book* create_book(const std::string& filename);
+
 void init();
 
 void on_book(const std::string& filename);
 Move probe(const Position& pos);
 void show_moves(const Position& pos);
+void benchmark(size_t probes);
+void compile(const Position& pos, std::istream& is);
 }
 
 #endif
@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "../../position.h"
+#include "../../experience.h"
+#include "../../thread.h"
+#include "../../uci.h"
+#include "compiled.h"
+
+using namespace std;
+using namespace Hypnos;
+
+namespace {
+constexpr char     HbkMagic[8] = {'H', 'Y', 'P', 'N', 'O', 'S', 'B', 'K'};
+constexpr uint32_t Version  = 1;
+
+//Deepest ply the compiler walks to
+constexpr int MaxCompilePly = 100;
+
+//Plies walked by the main thread before the remaining subtrees are split among the workers
+constexpr int SplitPly = 2;
+
+auto randomEngine = default_random_engine(now());
+
+using WeightedMoves = vector<pair<Move, int64_t>>;
+
+//A source of book moves: an opening book, or the experience file when 'book' is null
+struct BookSource {
+    unique_ptr<Book::Book> book;
+    string                 name;
+};
+
+//Walks the union of the sources from the root position. Each worker owns its
+//position, its transposition map and its entries, so workers share nothing but
+//the read-only sources.
+class BookCompiler {
+   public:
+    BookCompiler(const vector<BookSource>& s, int ply) :
+        sources(s),
+        maxPly(ply),
+        expMinDepth(Depth(Options["Experience Book Min Depth"])),
+        expEvalImportance(int(Options["Experience Book Eval Importance"])) {}
+
+    struct Worker {
+        vector<StateInfo>                     states;
+        unordered_map<Key, int>               visited;  //Lowest ply each position was expanded at
+        vector<Book::Compiled::CompiledEntry> entries;
+        vector<vector<Move>>*                 tasks = nullptr;  //Set for the main thread only
+    };
+
+    void walk(Worker& w, Position& pos, int ply, vector<Move>& path) const;
+    void run(const Position&                        root,
+             size_t                                 threadCount,
+             vector<Book::Compiled::CompiledEntry>& out) const;
+
+   private:
+    void experience_moves(Position& pos, WeightedMoves& moves) const;
+    bool rank(Position& pos, Book::Compiled::CompiledEntry& e) const;
+
+    const vector<BookSource>& sources;
+    const int                 maxPly;
+    const Depth               expMinDepth;
+    const int                 expEvalImportance;
+};
+
+//Experience moves are weighted by the same quality as the experience book
+void BookCompiler::experience_moves(Position& pos, WeightedMoves& moves) const {
+    for (const auto* exp = Experience::probe(pos.key()); exp; exp = exp->next())
+    {
+        if (exp->depth < expMinDepth)
+            continue;
+
+        const auto [q, maybeDraw] = exp->quality(pos, expEvalImportance);
+        if (q > 0 && !maybeDraw)
+            moves.emplace_back(exp->move, q);
+    }
+}
+
+//Merges the moves of all sources: the weights of each source are converted into
+//shares of 65535 and averaged over the sources knowing the position, then the
+//best moves are stored in descending order
+bool BookCompiler::rank(Position& pos, Book::Compiled::CompiledEntry& e) const {
+    WeightedMoves moves, merged;
+    int           active = 0;
+
+    for (const BookSource& source : sources)
+    {
+        moves.clear();
+        if (source.book)
+            source.book->get_weighted_moves(pos, moves);
+        else
+            experience_moves(pos, moves);
+
+        int64_t total = 0;
+        for (const auto& [m, w] : moves)
+            total += std::max<int64_t>(w, 0);
+
+        if (!total)
+            continue;
+
+        ++active;
+        for (const auto& [m, w] : moves)
+        {
+            if (w <= 0 || !pos.pseudo_legal(m) || !pos.legal(m))
+                continue;
+
+            int64_t share = w * 65535 / total;
+            auto    it    = find_if(merged.begin(), merged.end(),
+                                    [m = m](const pair<Move, int64_t>& x) { return x.first == m; });
+            if (it != merged.end())
+                it->second += share;
+            else
+                merged.emplace_back(m, share);
+        }
+    }
+
+    if (merged.empty())
+        return false;
+
+    stable_sort(merged.begin(), merged.end(),
+                [](const pair<Move, int64_t>& a, const pair<Move, int64_t>& b) {
+                    return a.second > b.second;
+                });
+
+    memset(&e, 0, sizeof(e));
+    e.key = pos.state()->key;
+    for (size_t i = 0; i < merged.size() && i < size_t(Book::Compiled::MaxMoves); ++i)
+    {
+        e.move[i]   = merged[i].first.raw();
+        e.weight[i] = uint16_t(std::clamp<int64_t>(merged[i].second / active, 1, 65535));
+    }
+
+    return true;
+}
+
+void BookCompiler::walk(Worker& w, Position& pos, int ply, vector<Move>& path) const {
+    if (ply >= maxPly)
+        return;
+
+    //A transposition is expanded again only when reached with more plies left
+    Key  key      = pos.state()->key;
+    auto it       = w.visited.find(key);
+    bool expanded = it != w.visited.end();
+    if (expanded && it->second <= ply)
+        return;
+
+    w.visited[key] = ply;
+
+    if (w.tasks && ply == SplitPly)
+    {
+        w.tasks->push_back(path);
+        return;
+    }
+
+    Book::Compiled::CompiledEntry e;
+    if (!rank(pos, e))
+        return;
+
+    if (!expanded)
+        w.entries.push_back(e);
+
+    for (int i = 0; i < Book::Compiled::MaxMoves && e.weight[i]; ++i)
+    {
+        Move m = Move(e.move[i]);
+
+        path.push_back(m);
+        pos.do_move(m, w.states[ply]);
+        walk(w, pos, ply + 1, path);
+        pos.undo_move(m);
+        path.pop_back();
+    }
+}
+
+void BookCompiler::run(const Position&                        root,
+                       size_t                                 threadCount,
+                       vector<Book::Compiled::CompiledEntry>& out) const {
+    vector<vector<Move>> tasks;
+    vector<Worker>       workers(std::max<size_t>(threadCount, 1));
+
+    for (Worker& w : workers)
+        w.states.resize(maxPly + 1);
+
+    //Main thread: walk the first plies and collect the subtrees below them
+    {
+        Worker&      w = workers[0];
+        Position     pos;
+        StateInfo    st;
+        vector<Move> path;
+
+        w.tasks = &tasks;
+        pos.set(root, &st, Threads.main());
+        walk(w, pos, 0, path);
+        w.tasks = nullptr;
+        w.visited.clear();
+    }
+
+    //Workers: replay the path of each subtree and walk it
+    atomic<size_t> nextTask = 0;
+    auto           work     = [&](Worker& w) {
+        Position  pos;
+        StateInfo st;
+        pos.set(root, &st, Threads.main());
+
+        for (size_t t; (t = nextTask.fetch_add(1)) < tasks.size();)
+        {
+            vector<Move>& path = tasks[t];
+
+            for (size_t i = 0; i < path.size(); ++i)
+                pos.do_move(path[i], w.states[i]);
+
+            walk(w, pos, int(path.size()), path);
+
+            for (size_t i = path.size(); i > 0; --i)
+                pos.undo_move(path[i - 1]);
+        }
+    };
+
+    vector<thread> threads;
+    for (size_t i = 1; i < workers.size(); ++i)
+        threads.emplace_back(work, ref(workers[i]));
+
+    work(workers[0]);
+
+    for (thread& th : threads)
+        th.join();
+
+    //Merge: the ranking only depends on the position, so duplicates are identical
+    out.clear();
+    for (Worker& w : workers)
+        out.insert(out.end(), w.entries.begin(), w.entries.end());
+
+    auto byKey = [](const Book::Compiled::CompiledEntry& a,
+                    const Book::Compiled::CompiledEntry& b) { return a.key < b.key; };
+    sort(out.begin(), out.end(), byKey);
+    out.erase(unique(out.begin(), out.end(),
+                     [](const Book::Compiled::CompiledEntry& a,
+                        const Book::Compiled::CompiledEntry& b) { return a.key == b.key; }),
+              out.end());
+}
+}
+
+namespace Hypnos::Book::Compiled {
+CompiledBook::CompiledBook() :
+    filename(),
+    entries(nullptr),
+    entryCount(0) {}
+
+CompiledBook::~CompiledBook() { close(); }
+
+string CompiledBook::type() const { return "HBK"; }
+
+void CompiledBook::close() {
+    bookMapping.unmap();
+
+    entries    = nullptr;
+    entryCount = 0;
+    filename.clear();
+}
+
+bool CompiledBook::open(const string& f) {
+    close();
+
+    if (Utility::is_empty_filename(f))
+        return true;
+
+    if (BookUtil::IsBigEndian || !bookMapping.map(Utility::map_path(f), false))
+    {
+        sync_cout << "info string Could not open book file: " << f << sync_endl;
+        return false;
+    }
+
+    const CompiledHeader* header = reinterpret_cast<const CompiledHeader*>(bookMapping.data());
+    size_t                size   = bookMapping.data_size();
+
+    if (size < sizeof(CompiledHeader) || memcmp(header->magic, HbkMagic, sizeof(HbkMagic))
+        || header->version != Version || header->entrySize != sizeof(CompiledEntry)
+        || (size - sizeof(CompiledHeader)) % sizeof(CompiledEntry))
+    {
+        sync_cout << "info string Invalid HBK book file: " << f << sync_endl;
+        bookMapping.unmap();
+        return false;
+    }
+
+    if (Options["Book Preload"])
+        bookMapping.will_need();
+
+    entries    = reinterpret_cast<const CompiledEntry*>(bookMapping.data()
+                                                     + sizeof(CompiledHeader));
+    entryCount = (size - sizeof(CompiledHeader)) / sizeof(CompiledEntry);
+    filename   = f;
+
+    sync_cout << "info string HBK Book [" << f << "] opened successfully" << sync_endl;
+
+    return true;
+}
+
+//Entries are sorted by key, so a position is a single binary search away
+const CompiledEntry* CompiledBook::find_entry(Key key) const {
+    const CompiledEntry* e =
+      std::lower_bound(entries, entries + entryCount, key,
+                       [](const CompiledEntry& x, Key k) { return x.key < k; });
+
+    return e != entries + entryCount && e->key == key ? e : nullptr;
+}
+
+//Returns the number of playable moves of the position, best first
+size_t CompiledBook::get_moves(const Position& pos, Move* moves, uint16_t* weights) const {
+    const CompiledEntry* e = entries ? find_entry(pos.state()->key) : nullptr;
+    size_t               n = 0;
+
+    for (int i = 0; e && i < MaxMoves && e->weight[i]; ++i)
+    {
+        //Guard against key collisions
+        Move m = Move(e->move[i]);
+        if (pos.pseudo_legal(m) && pos.legal(m))
+        {
+            moves[n]     = m;
+            weights[n++] = e->weight[i];
+        }
+    }
+
+    return n;
+}
+
+Move CompiledBook::probe(const Position& pos, size_t width, bool /*onlyGreen*/) const {
+    Move     moves[MaxMoves];
+    uint16_t weights[MaxMoves];
+    size_t   n = std::min(get_moves(pos, moves, weights), width);
+
+    if (!n)
+        return Move::none();
+
+    //Moves are already ranked: return a random move among the top 'width' ones
+    return moves[(randomEngine() - randomEngine.min()) % n];
+}
+
+void CompiledBook::get_weighted_moves(const Position&              pos,
+                                      vector<pair<Move, int64_t>>& moves) const {
+    Move     bookMoves[MaxMoves];
+    uint16_t weights[MaxMoves];
+    size_t   n = get_moves(pos, bookMoves, weights);
+
+    for (size_t i = 0; i < n; ++i)
+        moves.emplace_back(bookMoves[i], int64_t(weights[i]));
+}
+
+void CompiledBook::show_moves(const Position& pos) const {
+    stringstream ss;
+    Move         moves[MaxMoves];
+    uint16_t     weights[MaxMoves];
+    size_t       n = get_moves(pos, moves, weights);
+
+    if (!n)
+        ss << "No moves found for this position" << endl;
+    else
+    {
+        ss << "MOVE      WEIGHT" << endl;
+
+        for (size_t i = 0; i < n; ++i)
+            ss << setw(10) << left << UCI::move(moves[i], pos.is_chess960()) << fixed
+               << setprecision(2) << weights[i] * 100.0 / 65535 << "%" << endl;
+    }
+
+    //Not using sync_cout/sync_endl
+    cout << ss.str() << endl;
+}
+
+void CompiledBook::benchmark(size_t probes) const {
+    if (!entryCount)
+    {
+        sync_cout << "info string No HBK book loaded" << sync_endl;
+        return;
+    }
+
+    PRNG        rng(1070372);
+    vector<Key> keys(std::max<size_t>(probes, 1));
+    for (size_t i = 0; i < keys.size(); ++i)
+        keys[i] = i & 1 ? rng.rand<Key>() : entries[rng.rand<uint64_t>() % entryCount].key;
+
+    size_t  found = 0;
+    int64_t start = now_ns();
+
+    for (Key k : keys)
+        found += find_entry(k) != nullptr;
+
+    int64_t elapsed = std::max<int64_t>(now_ns() - start, 1);
+
+    sync_cout << "Entries          : " << entryCount << "\nProbes           : " << keys.size()
+              << " (" << found << " found)"
+              << "\nBinary search    : " << uint64_t(keys.size() * 1e9 / elapsed) << " probes/s"
+              << sync_endl;
+}
+}
+
+namespace Hypnos::Book {
+// compile_book <output> [ply N] [threads N] [book <file>]... [exp]
+// Walks the union of the given sources from the current position and writes a
+// compiled book. Without sources, the loaded book and experience file are used.
+void compile(const Position& pos, istream& is) {
+    string             output, token;
+    int                maxPly      = 20;
+    size_t             threadCount = Threads.size();
+    bool               useExp      = false;
+    vector<BookSource> sources;
+
+    is >> output;
+
+    auto add_book = [&](const string& f) {
+        string fn = Utility::map_path(f);
+        Book*  b  = create_book(fn);
+
+        if (b == nullptr)
+            sync_cout << "info string Unknown book type: " << f << sync_endl;
+        else if (!b->open(fn))
+            delete b;
+        else
+            sources.push_back({unique_ptr<Book>(b), f});
+    };
+
+    while (is >> token)
+        if (token == "ply")
+            is >> maxPly;
+        else if (token == "threads")
+            is >> threadCount;
+        else if (token == "book" && is >> token)
+            add_book(token);
+        else if (token == "exp")
+            useExp = true;
+
+    if (sources.empty() && !useExp)
+    {
+        string bookFile = (string) Options["Book File"];
+        if (!Utility::is_empty_filename(bookFile))
+            add_book(bookFile);
+
+        useExp = Experience::enabled();
+    }
+
+    if (useExp)
+    {
+        if (Experience::enabled())
+        {
+            Experience::wait_for_loading_finished();
+            sources.push_back({nullptr, "experience"});
+        }
+        else
+            sync_cout << "info string Experience is disabled, ignoring exp source" << sync_endl;
+    }
+
+    if (output.empty() || sources.empty())
+    {
+        sync_cout << "info string Usage: compile_book <output> [ply N] [threads N] "
+                     "[book <file>]... [exp]"
+                  << sync_endl;
+        return;
+    }
+
+    if (BookUtil::IsBigEndian)
+    {
+        sync_cout << "info string HBK books are not supported on big-endian platforms" << sync_endl;
+        return;
+    }
+
+    maxPly = std::clamp(maxPly, 1, MaxCompilePly);
+
+    TimePoint                       start = now();
+    vector<Compiled::CompiledEntry> entries;
+    BookCompiler(sources, maxPly).run(pos, threadCount, entries);
+
+    Compiled::CompiledHeader header;
+    memcpy(header.magic, HbkMagic, sizeof(HbkMagic));
+    header.version   = Version;
+    header.entrySize = sizeof(Compiled::CompiledEntry);
+
+    ofstream out(Utility::map_path(output), ios::out | ios::binary | ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+              streamsize(entries.size() * sizeof(Compiled::CompiledEntry)));
+    out.close();
+
+    if (!out)
+    {
+        sync_cout << "info string Could not write book file: " << output << sync_endl;
+        return;
+    }
+
+    sync_cout << "info string Compiled " << entries.size() << " positions from "
+              << sources.size() << " source(s) to ply " << maxPly << " into " << output << " in "
+              << now() - start << " ms" << sync_endl;
+}
+}
@@ -0,0 +1,68 @@
+#ifndef COMPILED_BOOK_H_INCLUDED
+#define COMPILED_BOOK_H_INCLUDED
+
+#include "../../misc.h"
+#include "../book.h"
+
+namespace Hypnos::Book::Compiled
+{
+    // Number of ranked moves stored for every position
+    constexpr int MaxMoves = 6;
+
+    // A compiled book (.hbk) is a 16 bytes header followed by entries of 32 bytes
+    // sorted by key in ascending order. Integers are stored in little-endian byte
+    // order so that the file can be probed in place from the mapping.
+    struct CompiledHeader
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t entrySize;
+    };
+
+    // Moves are ranked by the compiler in descending weight order,
+    // unused slots have a zero weight
+    struct CompiledEntry
+    {
+        uint64_t key;
+        uint16_t move[MaxMoves];
+        uint16_t weight[MaxMoves];
+    };
+
+    static_assert(sizeof(CompiledHeader) == 16);
+    static_assert(sizeof(CompiledEntry) == 32);
+
+    class CompiledBook : public Book
+    {
+    private:
+        std::string filename;
+        Utility::FileMapping bookMapping;
+        const CompiledEntry* entries;
+        size_t entryCount;
+
+    private:
+        const CompiledEntry* find_entry(Key key) const;
+        size_t get_moves(const Position& pos, Move* moves, uint16_t* weights) const;
+
+    public:
+        CompiledBook();
+        virtual ~CompiledBook();
+
+        CompiledBook(const CompiledBook&) = delete;
+        CompiledBook& operator=(const CompiledBook&) = delete;
+
+        virtual std::string type() const;
+
+        virtual bool open(const std::string& f);
+        virtual void close();
+
+        virtual Move probe(const Position& pos, size_t width, bool onlyGreen) const;
+        virtual void show_moves(const Position& pos) const;
+
+        virtual void get_weighted_moves(const Position&                        pos,
+                                        std::vector<std::pair<Move, int64_t>>& moves) const;
+
+        virtual void benchmark(size_t probes) const;
+    };
+}
+
+#endif
@@ -378,7 +378,9 @@ struct CtgMoveList: public vector<CtgMove> {
         });
     }
 };
+}
 
+namespace Hypnos::Book::CTG {
 struct CtgPositionData {
     Square epSquare;
     bool   invert;
@@ -409,10 +411,16 @@ struct CtgPositionData {
     CtgPositionData(const CtgPositionData&)            = delete;
     CtgPositionData& operator=(const CtgPositionData&) = delete;
 };
-}
 
-namespace Hypnos::Book::CTG {
 bool CtgBook::decode(const Position& pos, CtgPositionData& positionData) const {
+    prepare(pos, positionData);
+
+    //Lookup position page and data
+    return lookup_position(positionData);
+}
+
+//Fills the board and the encoded position, everything needed for a lookup
+void CtgBook::prepare(const Position& pos, CtgPositionData& positionData) const {
     positionData.epSquare = pos.ep_square();
     positionData.invert   = pos.side_to_move() == BLACK;
     positionData.flip     = needs_flipping(pos);
@@ -430,12 +438,6 @@ bool CtgBook::decode(const Position& pos, CtgPositionData& positionData) const {
 
     //Encode
     encode_position(pos, positionData);
-
-    //Lookup position page and data
-    if (!lookup_position(positionData))
-        return false;
-
-    return true;
 }
 
 void CtgBook::decode_board(const Position& pos, CtgPositionData& positionData) const {
@@ -748,7 +750,7 @@ bool CtgBook::read_position_data(CtgPositionData& positionData, uint32_t pageNum
     return false;
 }
 
-uint32_t CtgBook::gen_position_hash(CtgPositionData& positionData) const {
+uint32_t CtgBook::gen_position_hash(const CtgPositionData& positionData) const {
     int32_t hash = 0;
     int16_t tmp  = 0;
 
@@ -766,6 +768,85 @@ uint32_t CtgBook::gen_position_hash(CtgPositionData& positionData) const {
     return hash;
 }
 
+//Starts reading in the pages lookup_position() is going to visit, so that the
+//lookups of several positions wait for the disk together instead of in turn
+void CtgBook::read_ahead(const CtgPositionData& positionData) const {
+    uint32_t hash = gen_position_hash(positionData);
+
+    for (int32_t mask = 0; mask < 0x7FFFFFFF; mask = 2 * mask + 1)
+    {
+        uint32_t pageNum = (hash & mask) + mask;
+
+        if (pageNum < pageLowerBound)
+            continue;
+
+        if (size_t(pageNum) * 4 + 20 > cto.data_size())
+            break;
+
+        uint32_t pagePos =
+          BookUtil::read_big_endian<uint32_t>(cto.data() + pageNum * 4 + 16, cto.data_size());
+        if (pagePos != 0xFFFFFFFF)
+            ctg.will_need(size_t(pagePos + 1) * 4096, 4096);
+
+        if (pageNum >= pageUpperBound)
+            break;
+    }
+}
+
+bool CtgBook::find_cached(Key key, shared_ptr<const CtgPositionData>& positionData) const {
+    lock_guard<mutex> lk(cacheMutex);
+
+    auto it = cacheIndex.find(key);
+    if (it == cacheIndex.end())
+        return false;
+
+    //Move to the front, the least recently used entry is at the back
+    cacheList.splice(cacheList.begin(), cacheList, it->second);
+    positionData = it->second->second;
+    return true;
+}
+
+void CtgBook::cache(Key key, shared_ptr<const CtgPositionData> positionData) const {
+    constexpr size_t CacheSize = 4096;
+
+    lock_guard<mutex> lk(cacheMutex);
+
+    if (cacheIndex.count(key))
+        return;
+
+    cacheList.emplace_front(key, std::move(positionData));
+    cacheIndex[key] = cacheList.begin();
+
+    if (cacheList.size() > CacheSize)
+    {
+        cacheIndex.erase(cacheList.back().first);
+        cacheList.pop_back();
+    }
+}
+
+void CtgBook::clear_cache() {
+    lock_guard<mutex> lk(cacheMutex);
+
+    cacheList.clear();
+    cacheIndex.clear();
+}
+
+//Returns the decoded position, or nullptr if it is not in the book
+shared_ptr<const CtgPositionData> CtgBook::find_position(const Position& pos) const {
+    shared_ptr<const CtgPositionData> positionData;
+
+    if (!find_cached(pos.state()->key, positionData))
+    {
+        auto pd = make_shared<CtgPositionData>();
+        if (decode(pos, *pd))
+            positionData = pd;
+
+        cache(pos.state()->key, positionData);
+    }
+
+    return positionData;
+}
+
 bool CtgBook::lookup_position(CtgPositionData& positionData) const {
     uint32_t hash = gen_position_hash(positionData);
 
@@ -908,14 +989,20 @@ void CtgBook::get_moves(const Position&        pos,
     //Get legal moves for cross checking later
     MoveList legalMoves = MoveList<LEGAL>(pos);
 
-    //Position object to be used to play the moves
+    //Position object to be used to play the moves, copied without a FEN round-trip
     StateInfo si[2];
     Position  p;
-    p.set(pos.fen(), pos.is_chess960(), &si[0], pos.this_thread());
+    p.set(pos, &si[0], pos.this_thread());
 
     //Read position statistics
     get_stats(positionData, ctgMoveList.positionStats, false);
 
+    //First pass: collect the book moves and prepare the lookups of the child
+    //positions which are not cached, starting to read in all their pages
+    vector<shared_ptr<const CtgPositionData>>         children;
+    vector<pair<size_t, shared_ptr<CtgPositionData>>> pending;
+    vector<Key>                                       childKeys;
+
     int32_t movesCount = positionData.positionPage[0] >> 1;
     for (int i = 0; i < movesCount; ++i)
     {
@@ -932,10 +1019,17 @@ void CtgBook::get_moves(const Position&        pos,
                     //Play the move
                     p.do_move(ctgMove.sf_move(), si[1]);
 
-                    //Decode and get move info from the new position
-                    CtgPositionData pd;
-                    if (decode(p, pd))
-                        get_stats(pd, ctgMove, true);
+                    shared_ptr<const CtgPositionData> child;
+                    if (!find_cached(p.state()->key, child))
+                    {
+                        auto pd = make_shared<CtgPositionData>();
+                        prepare(p, *pd);
+                        read_ahead(*pd);
+                        pending.emplace_back(ctgMoveList.size(), pd);
+                    }
+
+                    children.push_back(child);
+                    childKeys.push_back(p.state()->key);
 
                     //Undo move
                     p.undo_move(ctgMove.sf_move());
@@ -950,6 +1044,21 @@ void CtgBook::get_moves(const Position&        pos,
         }
     }
 
+    //Second pass: look up the pending child positions, their pages should be
+    //arriving by now
+    for (auto& [index, pd] : pending)
+    {
+        if (lookup_position(*pd))
+            children[index] = pd;
+
+        cache(childKeys[index], children[index]);
+    }
+
+    //Get move info from the child positions
+    for (size_t i = 0; i < ctgMoveList.size(); ++i)
+        if (children[i])
+            get_stats(*children[i], ctgMoveList[i], true);
+
     //Calculate move weights
     ctgMoveList.calculate_weights();
 }
@@ -1022,6 +1131,7 @@ bool CtgBook::open(const string& f) {
 void CtgBook::close() {
     ctg.unmap();
     cto.unmap();
+    clear_cache();
 
     pageLowerBound = 0;
     pageUpperBound = 0;
@@ -1035,12 +1145,12 @@ Move CtgBook::probe(const Position& pos, size_t width, bool onlyGreen) const {
     if (!is_open())
         return Move::none();
 
-    CtgPositionData positionData;
-    if (!decode(pos, positionData))
+    auto positionData = find_position(pos);
+    if (!positionData)
         return Move::none();
 
     CtgMoveList ctgMoveList;
-    get_moves(pos, positionData, ctgMoveList);
+    get_moves(pos, *positionData, ctgMoveList);
 
     if (ctgMoveList.size() == 0)
         return Move::none();
@@ -1077,6 +1187,23 @@ Move CtgBook::probe(const Position& pos, size_t width, bool onlyGreen) const {
     return ctgMoveList[selectedMoveIndex].sf_move();
 }
 
+void CtgBook::get_weighted_moves(const Position& pos, vector<pair<Move, int64_t>>& moves) const {
+    if (!is_open())
+        return;
+
+    auto positionData = find_position(pos);
+    if (!positionData)
+        return;
+
+    CtgMoveList ctgMoveList;
+    get_moves(pos, *positionData, ctgMoveList);
+
+    //Same filter as probe(): red moves and moves with negative weight are never played
+    for (const CtgMove& m : ctgMoveList)
+        if (!m.red() && m.weight() >= 0)
+            moves.emplace_back(m.sf_move(), m.weight() + 1);
+}
+
 void CtgBook::show_moves(const Position& pos) const {
     stringstream ss;
 
@@ -1087,15 +1214,15 @@ void CtgBook::show_moves(const Position& pos) const {
     }
     else
     {
-        CtgPositionData positionData;
-        if (!decode(pos, positionData))
+        auto positionData = find_position(pos);
+        if (!positionData)
         {
             ss << "Position not found in book" << endl;
         }
         else
         {
             CtgMoveList ctgMoveList;
-            get_moves(pos, positionData, ctgMoveList);
+            get_moves(pos, *positionData, ctgMoveList);
 
             if (ctgMoveList.size() == 0)
             {
@@ -1,12 +1,16 @@
 #ifndef CTG_BOOK_H_INCLUDED
 #define CTG_BOOK_H_INCLUDED
 
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "../../misc.h"
 #include "../book.h"
 
 namespace
 {
-	struct CtgPositionData;
 	struct CtgMoveList;
 	struct CtgMove;
 	struct CtgMoveStats;
@@ -14,6 +18,8 @@ namespace
 
 namespace Hypnos::Book::CTG
 {
+	struct CtgPositionData;
+
 	class CtgBook : public Book
 	{
 	private:
@@ -23,8 +29,22 @@ namespace Hypnos::Book::CTG
 		uint32_t             pageUpperBound;
 		bool                 isOpen;
 
+		// LRU cache of decoded positions keyed by Zobrist key, nullptr if not in the book
+		using CachedPosition = std::pair<Key, std::shared_ptr<const CtgPositionData>>;
+
+		mutable std::mutex                                                   cacheMutex;
+		mutable std::list<CachedPosition>                                    cacheList;
+		mutable std::unordered_map<Key, std::list<CachedPosition>::iterator> cacheIndex;
+
 	private:
 		bool decode(const Position& pos, CtgPositionData& positionData) const;
+		void prepare(const Position& pos, CtgPositionData& positionData) const;
+		void read_ahead(const CtgPositionData& positionData) const;
+
+		bool find_cached(Key key, std::shared_ptr<const CtgPositionData>& positionData) const;
+		void cache(Key key, std::shared_ptr<const CtgPositionData> positionData) const;
+		void clear_cache();
+		std::shared_ptr<const CtgPositionData> find_position(const Position& pos) const;
 		void decode_board(const Position& pos, CtgPositionData& positionData) const;
 		void invert_board(CtgPositionData& positionData) const;
 		bool needs_flipping(const Position& pos) const;
@@ -32,7 +52,7 @@ namespace Hypnos::Book::CTG
 
 		void encode_position(const Position& pos, CtgPositionData& positionData) const;
 		bool read_position_data(CtgPositionData& positionData, uint32_t pageNum) const;
-		uint32_t gen_position_hash(CtgPositionData& positionData) const;
+		uint32_t gen_position_hash(const CtgPositionData& positionData) const;
 		bool lookup_position(CtgPositionData& positionData) const;
 
 		void get_stats(const CtgPositionData& positionData, CtgMoveStats& stats, bool isMove) const;
@@ -57,6 +77,9 @@ namespace Hypnos::Book::CTG
 		virtual Move probe(const Position& pos, size_t width, bool onlyGreen) const;
 
 		virtual void show_moves(const Position& pos) const;
+
+		virtual void get_weighted_moves(const Position& pos,
+		                                std::vector<std::pair<Move, int64_t>>& moves) const;
 	};
 }
 
@@ -3,6 +3,9 @@
 #include <iomanip>
 #include <random>
 #include <map>
+#if defined(USE_AVX2)
+    #include <immintrin.h>
+#endif
 #include "../../movegen.h"
 #include "../../uci.h"
 #include "polyglot.h"
@@ -227,38 +230,6 @@ const union {
          0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
          0xF8D626AAAF278509ULL}};
 
-// Polyglot_key() returns the Polyglot hash key of the given position
-Key Polyglot_key(const Position& pos) {
-    Key      key = 0;
-    Bitboard b   = pos.pieces();
-
-    while (b)
-    {
-        Square s  = pop_lsb(b);
-        Piece  pc = pos.piece_on(s);
-
-        // Polyglot pieces are: BP = 0, WP = 1, BN = 2, ... BK = 10, WK = 11
-        key ^= PG.Zobrist.psq[2 * (type_of(pc) - 1) + (color_of(pc) == WHITE)][s];
-    }
-
-    if (pos.can_castle(WHITE_OO))
-        key ^= PG.Zobrist.castling[0];
-    if (pos.can_castle(WHITE_OOO))
-        key ^= PG.Zobrist.castling[1];
-    if (pos.can_castle(BLACK_OO))
-        key ^= PG.Zobrist.castling[2];
-    if (pos.can_castle(BLACK_OOO))
-        key ^= PG.Zobrist.castling[3];
-
-    if (pos.ep_square() != SQ_NONE)
-        key ^= PG.Zobrist.enpassant[file_of(pos.ep_square())];
-
-    if (pos.side_to_move() == WHITE)
-        key ^= PG.Zobrist.turn;
-
-    return key;
-}
-
 Move make_move(const PolyglotEntry& e) {
     // A Polyglot book move is encoded as follows:
     //
@@ -278,7 +249,27 @@ Move make_move(const PolyglotEntry& e) {
     return move;
 }
 
-void read_poly_entry(PolyglotEntry& e, size_t& pos, unsigned char* buffer, size_t bufferLen) {
+// Converts a book move to our representation for the given position, or returns
+// Move::none() if it is not legal there. Castling ("king captures rook") and en
+// passant are recognized from the board, so no move generation is needed.
+Move decode_move(const Position& pos, const PolyglotEntry& e) {
+    Move   move = make_move(e);
+    Square from = move.from_sq(), to = move.to_sq();
+    Piece  pc   = pos.piece_on(from);
+
+    if (move.type_of() != PROMOTION)
+    {
+        if (pc == make_piece(pos.side_to_move(), KING)
+            && pos.piece_on(to) == make_piece(pos.side_to_move(), ROOK))
+            move = Move::make<CASTLING>(from, to);
+        else if (type_of(pc) == PAWN && to == pos.ep_square())
+            move = Move::make<EN_PASSANT>(from, to);
+    }
+
+    return pos.pseudo_legal(move) && pos.legal(move) ? move : Move::none();
+}
+
+void read_poly_entry(PolyglotEntry& e, size_t& pos, const unsigned char* buffer, size_t bufferLen) {
     assert(buffer && bufferLen);
     assert(pos + sizeof(PolyglotEntry) <= bufferLen);
 
@@ -302,41 +293,145 @@ struct PolyglotBookMove {
     }
 };
 
+// Buckets larger than this are narrowed by binary search before being scanned
+constexpr size_t MaxScanEntries = 64;
+
+// Returns the index of the first entry in [low, high) whose key is 'key', or
+// 'high' if there is none. Keys are compared in their big-endian file layout,
+// so no entry needs to be byte-swapped.
+size_t scan_for_key(const unsigned char* data, size_t low, size_t high, Key key) {
+    uint64_t target;
+    unsigned char be[sizeof(Key)];
+    for (size_t i = 0; i < sizeof(Key); ++i)
+        be[i] = (unsigned char) (key >> (8 * (sizeof(Key) - 1 - i)));
+    memcpy(&target, be, sizeof(target));
+
+    // Issue all the cache line requests of the range up front so that the
+    // misses overlap instead of being serviced one after the other.
+    for (size_t offset = low * sizeof(PolyglotEntry); offset < high * sizeof(PolyglotEntry);
+         offset += 64)
+        prefetch(const_cast<unsigned char*>(data + offset));
+
+    size_t i = low;
+
+#if defined(USE_AVX2)
+    // Two entries per 256-bit load, keys are in 64-bit lanes 0 and 2
+    const __m256i t = _mm256_set1_epi64x((long long) target);
+    for (; i + 2 <= high; i += 2)
+    {
+        __m256i v    = _mm256_loadu_si256((const __m256i*) (data + i * sizeof(PolyglotEntry)));
+        int     mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, t)));
+        if (mask & 1)
+            return i;
+        if (mask & 4)
+            return i + 1;
+    }
+#endif
+
+    for (; i < high; ++i)
+    {
+        uint64_t k;
+        memcpy(&k, data + i * sizeof(PolyglotEntry), sizeof(k));
+        if (k == target)
+            return i;
+    }
+
+    return high;
+}
+
 auto randomEngine = default_random_engine(now());
 }  // namespace
 
 namespace Hypnos::Book::Polyglot {
-unsigned char* PolyglotBook::data() const { return bookData; }
+const ZobristKeys Zobrist = [] {
+    ZobristKeys z{};
 
-size_t PolyglotBook::data_size() const { return bookDataLength; }
+    // Polyglot pieces are: BP = 0, WP = 1, BN = 2, ... BK = 10, WK = 11
+    for (Color c : {WHITE, BLACK})
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+            for (Square s = SQ_A1; s <= SQ_H8; ++s)
+                z.psq[make_piece(c, pt)][s] = PG.Zobrist.psq[2 * (pt - 1) + (c == WHITE)][s];
 
-size_t PolyglotBook::find_first_pos(Key key) const {
-    assert(has_data());
+    // Polyglot castling flags follow the same order as our CastlingRights bits
+    for (int cr = 0; cr < CASTLING_RIGHT_NB; ++cr)
+        for (int i = 0; i < 4; ++i)
+            if (cr & (1 << i))
+                z.castling[cr] ^= PG.Zobrist.castling[i];
 
-    size_t        low = 0, mid, high = total_entries() - 1;
-    PolyglotEntry e;
+    for (File f = FILE_A; f <= FILE_H; ++f)
+        z.enpassant[f] = PG.Zobrist.enpassant[f];
+
+    // Unlike ours, the Polyglot side key is set when White is to move
+    z.side = PG.Zobrist.turn;
+
+    return z;
+}();
 
-    assert(low <= high);
+const unsigned char* PolyglotBook::data() const { return bookData; }
 
-    size_t curPos;
+size_t PolyglotBook::data_size() const { return bookDataLength; }
+
+Key PolyglotBook::read_key(size_t index) const {
+    return BookUtil::read_big_endian<uint64_t>(bookData + index * sizeof(PolyglotEntry),
+                                               sizeof(uint64_t));
+}
+
+// Returns the first entry in [low, high) whose key is not less than 'key', or
+// 'high' if there is none
+size_t PolyglotBook::lower_bound(Key key, size_t low, size_t high) const {
     while (low < high)
     {
-        mid = (low + high) / 2;
+        size_t mid = low + (high - low) / 2;
 
-        assert(mid >= low && mid < high);
+        if (read_key(mid) < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
 
-        curPos = mid * sizeof(PolyglotEntry);
-        read_poly_entry(e, curPos, bookData, bookDataLength);
+    return low;
+}
 
-        if (key <= e.key)
-            high = mid;
-        else
+// Fills the fence entries strictly between two known ones by recursive bisection
+void PolyglotBook::build_index(size_t bucketLow, size_t bucketHigh) {
+    if (bucketHigh - bucketLow < 2)
+        return;
+
+    size_t mid = bucketLow + (bucketHigh - bucketLow) / 2;
+    fence[mid] = lower_bound(Key(mid) << (64 - fenceBits), fence[bucketLow], fence[bucketHigh]);
+
+    build_index(bucketLow, mid);
+    build_index(mid, bucketHigh);
+}
+
+// Plain binary search over the whole book, kept as reference for 'bookbench'
+size_t PolyglotBook::find_first_pos(Key key) const {
+    assert(has_data());
+
+    size_t pos = lower_bound(key, 0, total_entries());
+    return pos < total_entries() && read_key(pos) == key ? pos : total_entries();
+}
+
+// Returns the first entry with the given key, or total_entries() if not found.
+// The fence index gives the bucket of the key with a single lookup.
+size_t PolyglotBook::find_first_indexed(Key key) const {
+    assert(has_data() && !fence.empty());
+
+    size_t bucket = fenceBits ? size_t(key >> (64 - fenceBits)) : 0;
+    size_t low = fence[bucket], high = fence[bucket + 1];
+
+    while (high - low > MaxScanEntries)
+    {
+        size_t mid = low + (high - low) / 2;
+
+        if (read_key(mid) < key)
             low = mid + 1;
+        else
+            high = mid + 1;
     }
 
-    assert(low == high);
-
-    return low;
+    size_t pos = scan_for_key(bookData, low, high, key);
+    return pos < high ? pos : total_entries();
 }
 
 bool PolyglotBook::has_data() const { return bookData && bookDataLength; }
@@ -353,11 +448,11 @@ void PolyglotBook::get_moves(const Position& pos, vector<PolyglotBookMove>& book
     bookMoves.clear();
 
     //Find moves
-    Key           key = Polyglot_key(pos);
+    Key           key = pos.polyglot_key();
     PolyglotEntry e;
 
-    size_t curPos = find_first_pos(key) * sizeof(PolyglotEntry);
-    while (true)
+    size_t curPos = find_first_indexed(key) * sizeof(PolyglotEntry);
+    while (curPos + sizeof(PolyglotEntry) <= bookDataLength)
     {
         //Read a new entry
         read_poly_entry(e, curPos, bookData, bookDataLength);
@@ -370,21 +465,17 @@ void PolyglotBook::get_moves(const Position& pos, vector<PolyglotBookMove>& book
         if (e.count == 0)
             continue;
 
-        Move move = make_move(e);
-        for (const auto& m : MoveList<LEGAL>(pos))
-        {
-            if (move.raw() == (m.raw() ^ m.type_of()))
-            {
-                bookMoves.push_back(PolyglotBookMove(e, m));
-            }
-        }
+        Move move = decode_move(pos, e);
+        if (move != Move::none())
+            bookMoves.push_back(PolyglotBookMove(e, move));
     }
 }
 
 PolyglotBook::PolyglotBook() :
     filename(),
     bookData(nullptr),
-    bookDataLength(0) {}
+    bookDataLength(0),
+    fenceBits(0) {}
 
 PolyglotBook::~PolyglotBook() { close(); }
 
@@ -392,7 +483,10 @@ string PolyglotBook::type() const { return "BIN"; }
 
 void PolyglotBook::close() {
     if (bookData)
-        free(bookData);
+        Position::track_polyglot_key(false);
+
+    bookMapping.unmap();
+    fence.clear();
 
     bookData       = nullptr;
     bookDataLength = 0;
@@ -411,31 +505,32 @@ bool PolyglotBook::open(const string& f) {
     if (Utility::is_empty_filename(f))
         return true;
 
-    Utility::FileMapping fm;
-    if (!fm.map(Utility::map_path(f), false))
+    //Entries are probed in place: the read-only mapping is shared through the
+    //page cache by all engines using the same book, and nothing is copied
+    if (!bookMapping.map(Utility::map_path(f), false))
     {
         sync_cout << "info string Could not open book file: " << f << sync_endl;
         return false;
     }
 
-    void* inData = malloc(fm.data_size());
-    if (!inData)
-    {
-        sync_cout << "info string Could not allocate " << Utility::format_bytes(fm.data_size(), 2)
-                  << " of memory for reading book file: " << f << sync_endl;
-        return false;
-    }
-
-    //Read
-    memcpy(inData, fm.data(), fm.data_size());
+    if (Options["Book Preload"])
+        bookMapping.will_need();
 
-    //Assign variables and read data from file
-    bookDataLength = fm.data_size();
-    bookData       = (unsigned char*) inData;
+    bookDataLength = bookMapping.data_size();
+    bookData       = bookMapping.data();
     filename       = f;
 
-    //Close the book file
-    fm.unmap();
+    //Build the fence index: about 4 to 8 entries per bucket, at most 2^20 buckets
+    size_t entries = total_entries();
+    fenceBits      = 0;
+    while (fenceBits < 20 && (size_t(8) << fenceBits) <= entries)
+        ++fenceBits;
+
+    fence.assign((size_t(1) << fenceBits) + 1, 0);
+    fence.back() = entries;
+    build_index(0, fence.size() - 1);
+
+    Position::track_polyglot_key(true);
 
     sync_cout << "info string BIN Book [" << f << "] opened successfully" << sync_endl;
 
@@ -496,6 +591,18 @@ Move PolyglotBook::probe(const Position& pos, size_t width, bool /*onlyGreen*/)
     return bookMoves[selectedMoveIndex].move;
 }
 
+void PolyglotBook::get_weighted_moves(const Position&              pos,
+                                      vector<pair<Move, int64_t>>& moves) const {
+    if (!has_data())
+        return;
+
+    vector<PolyglotBookMove> bookMoves;
+    get_moves(pos, bookMoves);
+
+    for (const PolyglotBookMove& mv : bookMoves)
+        moves.emplace_back(mv.move, (int64_t) mv.entry.count);
+}
+
 void PolyglotBook::show_moves(const Position& pos) const {
     stringstream ss;
 
@@ -532,4 +639,47 @@ void PolyglotBook::show_moves(const Position& pos) const {
 
     cout << ss.str() << endl;
 }
+
+// Measures probes/s of the fence index against a plain binary search over the
+// whole book. Half of the keys are taken from the book, the other half are
+// random and will usually miss. Called by the "bookbench" command.
+void PolyglotBook::benchmark(size_t probes) const {
+    if (!has_data() || !total_entries())
+    {
+        sync_cout << "info string No BIN book loaded" << sync_endl;
+        return;
+    }
+
+    PRNG        rng(1070372);
+    vector<Key> keys(std::max<size_t>(probes, 1));
+    for (size_t i = 0; i < keys.size(); ++i)
+        keys[i] = i & 1 ? rng.rand<Key>() : read_key(rng.rand<uint64_t>() % total_entries());
+
+    auto run = [&](auto find) {
+        size_t  found = 0;
+        int64_t start = now_ns();
+
+        for (Key k : keys)
+            found += find(k) != total_entries();
+
+        return make_pair(found, std::max<int64_t>(now_ns() - start, 1));
+    };
+
+    auto indexed = [&](Key k) { return find_first_indexed(k); };
+    auto binary  = [&](Key k) { return find_first_pos(k); };
+
+    run(indexed);  // Warm up the page cache for both methods
+    auto [binaryFound, binaryTime]   = run(binary);
+    auto [indexedFound, indexedTime] = run(indexed);
+
+    assert(binaryFound == indexedFound);
+
+    sync_cout << "Entries          : " << total_entries()
+              << "\nFence index      : " << fence.size() - 1 << " buckets, "
+              << Utility::format_bytes(fence.size() * sizeof(size_t), 2)
+              << "\nProbes           : " << keys.size() << " (" << indexedFound << " found)"
+              << "\nBinary search    : " << uint64_t(keys.size() * 1e9 / binaryTime) << " probes/s"
+              << "\nIndexed lookup   : " << uint64_t(keys.size() * 1e9 / indexedTime)
+              << " probes/s" << sync_endl;
+}
 }
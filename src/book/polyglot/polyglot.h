@@ -2,6 +2,7 @@
 #define POLYGLOT_BOOK_H_INCLUDED
 
 #include <vector>
+#include "../../misc.h"
 #include "../book.h"
 
 namespace
@@ -12,20 +13,42 @@ namespace
 
 namespace Hypnos::Book::Polyglot
 {
+    // The Polyglot random keys, indexed like our own Zobrist keys so that
+    // Position can maintain the Polyglot key incrementally
+    struct ZobristKeys
+    {
+        Key psq[PIECE_NB][SQUARE_NB];
+        Key castling[CASTLING_RIGHT_NB];
+        Key enpassant[FILE_NB];
+        Key side;
+    };
+
+    extern const ZobristKeys Zobrist;
+
     class PolyglotBook : public Book
     {
     private:
         std::string filename;
-        unsigned char* bookData;
+        Utility::FileMapping bookMapping;
+        const unsigned char* bookData;
         size_t bookDataLength;
 
+        // Fence index: fence[b] is the first entry whose key has the top
+        // 'fenceBits' bits >= b, so a probe only scans fence[b]..fence[b + 1]
+        std::vector<size_t> fence;
+        int fenceBits;
+
     private:
-        unsigned char* data() const;
+        const unsigned char* data() const;
         size_t data_size() const;
         bool has_data() const;
         size_t total_entries() const;
 
+        Key read_key(size_t index) const;
+        size_t lower_bound(Key key, size_t low, size_t high) const;
+        void build_index(size_t bucketLow, size_t bucketHigh);
         size_t find_first_pos(Key key) const;
+        size_t find_first_indexed(Key key) const;
         void get_moves(const Position& pos, std::vector<PolyglotBookMove>& bookMoves) const;
 
     public:
@@ -43,6 +66,11 @@ namespace Hypnos::Book::Polyglot
         virtual Move probe(const Position& pos, size_t width, bool onlyGreen) const;
 
         void show_moves(const Position& pos) const;
+
+        virtual void get_weighted_moves(const Position&                        pos,
+                                        std::vector<std::pair<Move, int64_t>>& moves) const;
+
+        virtual void benchmark(size_t probes) const;
     };
 }
 
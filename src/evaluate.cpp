@@ -69,6 +69,14 @@ std::unordered_map<NNUE::NetSize, EvalFile> EvalFiles = {
 int               NNUE::MaterialisticEvaluationStrategy = 0;
 int               NNUE::PositionalEvaluationStrategy    = 0;
 
+namespace {
+
+// Set by verify() and reset by init(), so that the nets are checked only once
+// after they change rather than on every 'go'.
+bool NetsVerified = false;
+
+}
+
 // Tries to load a NNUE network at startup time, or when the engine
 // receives a UCI command "setoption name EvalFile value nn-[a-z0-9]{12}.nnue"
 // The name of the NNUE network is always retrieved from the EvalFile option.
@@ -78,6 +86,8 @@ int               NNUE::PositionalEvaluationStrategy    = 0;
 // variable to have the engine search in a special directory in their distro.
 void NNUE::init() {
 
+    NetsVerified = false;
+
     for (auto& [netSize, evalFile] : EvalFiles)
     {
         // Replace with
@@ -137,6 +147,9 @@ void NNUE::init() {
 // Verifies that the last net used was loaded successfully
 void NNUE::verify() {
 
+    if (NetsVerified)
+        return;
+
     for (const auto& [netSize, evalFile] : EvalFiles)
     {
         // Replace with
@@ -171,6 +184,8 @@ void NNUE::verify() {
 
         sync_cout << "info string NNUE evaluation using " << user_eval_file << sync_endl;
     }
+
+    NetsVerified = true;
 }
 }
 
@@ -195,8 +210,16 @@ Value Eval::evaluate(const Position& pos) {
     int  nnueComplexity;
     int  v;
 
-    Value nnue = smallNet ? NNUE::evaluate<NNUE::Small>(pos, true, &nnueComplexity, psqtOnly)
-                          : NNUE::evaluate<NNUE::Big>(pos, true, &nnueComplexity, false);
+    NNUE::AccumulatorUpdates updates;
+
+    Value nnue = smallNet
+                 ? NNUE::evaluate<NNUE::Small>(pos, true, &nnueComplexity, psqtOnly, &updates)
+                 : NNUE::evaluate<NNUE::Big>(pos, true, &nnueComplexity, false, &updates);
+
+    Search::SearchStats& stats = pos.this_thread()->stats;
+    stats.inc(!smallNet ? Search::EVAL_BIG : psqtOnly ? Search::EVAL_PSQT_ONLY : Search::EVAL_SMALL);
+    stats.inc(Search::ACC_UPDATES, updates.incremental);
+    stats.inc(Search::ACC_REFRESHES, updates.refreshes);
 
     int optimism = pos.this_thread()->optimism[pos.side_to_move()];
 
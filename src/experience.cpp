@@ -16,22 +16,44 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <new>
+#include <numeric>
+#include <optional>
 #include <vector>
 #include <cstdio>  //For: remove()
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/file.h>
+    #include <sys/resource.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+
+    #ifdef __linux__
+        #include <sys/syscall.h>
+    #endif
+#endif
+
 #include "misc.h"
 #include "uci.h"
 #include "position.h"
 #include "thread.h"
 #include "experience.h"
+#include "expserver.h"
 
 //using namespace std;
 using namespace Hypnos;
@@ -319,14 +341,14 @@ std::pair<int, bool> ExpEntryEx::quality(Position& pos, const int evalImportance
                 break;
 
             // Find best next experience move (shallow search)
-            const ExpEntryEx* temp2 = temp1->next;
+            const ExpEntryEx* temp2 = temp1->next();
 
             while (temp2)
             {
                 if (temp2->compare(temp1) > 0)
                     temp1 = temp2;
 
-                temp2 = temp2->next;
+                temp2 = temp2->next();
             }
 
             if (lastExp[me])
@@ -373,17 +395,137 @@ constexpr usize WriteBufferSize = 1024;
 constexpr usize WriteBufferSize = 1024 * 1024 * 16;
 #endif
 
+// Number of moves in a chunk of memory for the moves learnt while playing
+constexpr usize ChunkSize = 1024 * 64;
+
+// Compaction rewrites the positions of one key range at a time, so that its copy
+// of the experience only holds a fraction of the positions
+constexpr usize CompactionParts = 8;
+
+#ifndef _WIN32
+// An experience file opened with an advisory lock held until destruction. Writers
+// append whole entries with O_APPEND under an exclusive lock and readers take a
+// shared lock, so a reader never sees a partially written entry and concurrent
+// engines sharing a file never interleave their entries. The file is only replaced
+// under an exclusive lock, so the lock is taken again if that happened meanwhile.
+class ExpFileLock {
+   public:
+    ExpFileLock(const std::string& fn, const bool exclusive) {
+        while (true)
+        {
+            fd = exclusive ? open(fn.c_str(), O_RDWR | O_APPEND | O_CREAT, 0644)
+                           : open(fn.c_str(), O_RDONLY);
+
+            if (fd == -1)
+                return;
+
+            struct stat locked, current;
+
+            if (flock(fd, exclusive ? LOCK_EX : LOCK_SH) != 0 || fstat(fd, &locked) != 0)
+                break;
+
+            if (::stat(fn.c_str(), &current) != 0
+                || (locked.st_dev == current.st_dev && locked.st_ino == current.st_ino))
+                return;
+
+            close(fd);
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    ~ExpFileLock() {
+        if (fd != -1)
+            close(fd);  // Releases the lock
+    }
+
+    ExpFileLock(const ExpFileLock&)            = delete;
+    ExpFileLock& operator=(const ExpFileLock&) = delete;
+
+    [[nodiscard]] bool is_open() const { return fd != -1; }
+
+    // Size and identity of the file, the identity changes when the file is replaced
+    bool stat(usize& size, u64& id) const {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+            return false;
+
+        size = usize(st.st_size);
+        id   = (u64(st.st_dev) << 32) ^ u64(st.st_ino);
+        return true;
+    }
+
+    bool read_at(char* data, usize n, usize offset) const {
+        while (n)
+        {
+            const ssize_t r = pread(fd, data, n, off_t(offset));
+            if (r <= 0)
+                return false;
+
+            data += r;
+            n -= usize(r);
+            offset += usize(r);
+        }
+
+        return true;
+    }
+
+    bool append(const char* data, usize n) const {
+        while (n)
+        {
+            const ssize_t w = write(fd, data, n);
+            if (w <= 0)
+                return false;
+
+            data += w;
+            n -= usize(w);
+        }
+
+        return true;
+    }
+
+   private:
+    int fd;
+};
+#endif
+
+// A move learnt while playing, to be appended to the experience file
+struct NewExpEntry {
+    Key        key;
+    ExpEntryEx exp;
+};
+
 class ExperienceData {
    private:
     std::string _filename;
 
-    std::vector<ExpEntryEx*> _expData;
-    std::vector<ExpEntryEx*> _newPvExp;
-    std::vector<ExpEntryEx*> _newMultiPvExp;
-    std::vector<ExpEntryEx*> _oldExpData;
+    std::vector<ExpEntryEx*>  _expData;  // Chunks of memory holding the blocks of moves
+    ExpEntryEx*               _expNext = nullptr;
+    usize                     _expFree = 0;
+    std::vector<ExpEntryEx>   _block;
+    std::vector<NewExpEntry>  _newPvExp;
+    std::vector<NewExpEntry>  _newMultiPvExp;
+
+    std::vector<std::vector<ExpEntryEx*>> _freeBlocks;  // Replaced blocks by number of moves
 
     ExpMap _mainExp;
 
+    // Bytes of the experience file already linked and identity of that file, so
+    // that the entries appended by other engines can be followed incrementally
+    usize _ingested = 0;
+    u64   _fileId   = 0;
+
+    // Moves in the file and how many of them are duplicates, for the fragmentation
+    usize _fileMoves      = 0;
+    usize _duplicateMoves = 0;
+    usize _newDuplicates  = 0;
+
+    std::mutex        _fileMutex;  // Serializes the updates of the followed file
+    std::thread       _compactorThread;
+    std::atomic<bool> _compacting{false};
+    std::atomic<bool> _abortCompaction{false};
+
     bool                    _loading;
     std::atomic<bool>       _abortLoading;
     std::atomic<bool>       _loadingResult;
@@ -397,87 +539,278 @@ class ExperienceData {
         wait_for_load_finished();
         assert(_loaderThread == nullptr);
 
-        // Clear new exp (this will also flush all new experience data to '_oldExpData'
-        // which we will delete later in this function
+        // Make sure we are not compacting the experience file
+        _abortCompaction.store(true, std::memory_order_relaxed);
+        if (_compactorThread.joinable())
+            _compactorThread.join();
+
+        _abortCompaction.store(false, std::memory_order_relaxed);
+
         clear_new_exp();
 
         // Free main exp data
         for (ExpEntryEx*& p : _expData)
             free(p);
 
-        // Delete previous game experience data
-        for (ExpEntryEx*& p : _oldExpData)
-            delete p;
-
         // Clear
         _mainExp.clear();
-        _oldExpData.clear();
         _expData.clear();
+        _freeBlocks.clear();
+        _expNext  = nullptr;
+        _expFree  = 0;
+        _ingested       = 0;
+        _fileId         = 0;
+        _fileMoves      = 0;
+        _duplicateMoves = 0;
     }
 
     void clear_new_exp() {
-        // Copy exp data to another buffer to be deleted when the whole object is destroyed or new exp file is loaded
-        for (auto& newExp : {_newPvExp, _newMultiPvExp})
-            std::copy(newExp.begin(), newExp.end(), back_inserter(_oldExpData));
-
-        // Clear vectors
         _newPvExp.clear();
         _newMultiPvExp.clear();
+        _newDuplicates = 0;
     }
 
-    bool link_entry(ExpEntryEx* exp) {
-        ExpIterator itr = _mainExp.find(exp->key);
+    // Makes sure that the next 'n' moves fit in the current chunk of memory
+    bool reserve(const usize n) {
+        if (n <= _expFree)
+            return true;
 
-        // If new entry: insert into map and continue
-        if (itr == _mainExp.end())
+        const usize size  = std::max(n, ChunkSize);
+        auto*       chunk = static_cast<ExpEntryEx*>(malloc(size * sizeof(ExpEntryEx)));
+
+        if (!chunk)
+            return false;
+
+        _expData.push_back(chunk);
+        _expNext = chunk;
+        _expFree = size;
+
+        return true;
+    }
+
+    // Returns room for 'n' moves, reusing a block of that size replaced by a bigger
+    // one if there is any. Moves are only linked while no search is running, so the
+    // replaced blocks are not read anymore.
+    ExpEntryEx* allocate(const usize n) {
+        if (n < _freeBlocks.size() && !_freeBlocks[n].empty())
         {
-            _mainExp[exp->key] = exp;
-            return true;
+            ExpEntryEx* block = _freeBlocks[n].back();
+            _freeBlocks[n].pop_back();
+            return block;
         }
 
-        // If existing entry and same move exists then merge
-        ExpEntryEx* exp2 = itr->second->find(exp->move);
-        if (exp2)
+        if (!reserve(n))
+            return nullptr;
+
+        ExpEntryEx* block = _expNext;
+        _expNext += n;
+        _expFree -= n;
+
+        return block;
+    }
+
+    // Returns the experience entry of move 'exp' of position 'k' as stored in the file
+    static void to_file_entry(const Key k, const ExpEntryEx& exp, char* data) {
+        std::memset(data, 0, sizeof(Current::ExpEntry));
+        new (data) Current::ExpEntry(k, exp.move, (ExpValue) exp.value, (ExpDepth) exp.depth,
+                                     exp.count);
+    }
+
+    // Merges 'n' moves into the experience of position 'k', a move already known
+    // being merged like in Current::ExpEntry::merge(). The moves of a position are
+    // stored in one block sorted by compare(), so when a position gets a new move
+    // it is copied to a bigger block and its old block is kept for reuse. Returns
+    // the number of moves merged.
+    usize link_entries(const Key k, const ExpEntryEx* moves, const usize n) {
+        ExpIterator itr = _mainExp.find(k);
+
+        _block.clear();
+        if (itr != _mainExp.end())
+            for (const ExpEntryEx* exp = itr->second; exp; exp = exp->next())
+                _block.push_back(*exp);
+
+        const usize oldSize = _block.size();
+        usize       merged  = 0;
+
+        for (usize i = 0; i < n; ++i)
         {
-            exp2->merge(exp);
-            return false;
+            auto it = std::find_if(_block.begin(), _block.end(),
+                                   [&](const ExpEntryEx& exp) { return exp.move == moves[i].move; });
+
+            if (it != _block.end())
+            {
+                it->merge(moves[i]);
+                ++merged;
+            }
+            else
+                _block.push_back(moves[i]);
         }
 
-        // If existing entry and different move then insert sorted based on pseudo-quality
-        exp2 = itr->second;
+        std::stable_sort(_block.begin(), _block.end(),
+                         [](const ExpEntryEx& a, const ExpEntryEx& b) { return a.compare(&b) > 0; });
+
+        for (ExpEntryEx& exp : _block)
+            exp.last = false;
 
-        do
+        _block.back().last = true;
+
+        ExpEntryEx* block = _block.size() == oldSize ? itr->second : allocate(_block.size());
+        if (!block)
+            return merged;
+
+        std::copy(_block.begin(), _block.end(), block);
+
+        if (_block.size() != oldSize)
         {
-            if (exp->compare(exp2) > 0)
+            if (oldSize)
             {
-                if (exp2 == itr->second)
-                {
-                    itr->second = exp;
-                    exp->next   = exp2;
-                }
-                else
-                {
-                    exp->next  = exp2->next;
-                    exp2->next = exp;
-                }
+                if (_freeBlocks.size() <= oldSize)
+                    _freeBlocks.resize(oldSize + 1);
 
-                return true;
+                _freeBlocks[oldSize].push_back(itr->second);
+            }
+
+            _mainExp[k] = block;
+        }
+
+        return merged;
+    }
+
+    // Links 'expCount' entries read from an experience file, one block per position.
+    // The entries are grouped by position keeping their file order, so that the moves
+    // of a position are merged in the same order as they were learnt. Returns the
+    // number of duplicate moves.
+    usize link_file_entries(const Current::ExpEntry* fileData, const usize expCount) {
+        std::vector<usize> order(expCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](const usize a, const usize b) {
+            return fileData[a].key < fileData[b].key;
+        });
+
+        usize                   duplicateMoves = 0;
+        std::vector<ExpEntryEx> moves;
+
+        for (usize i = 0; i < expCount && !_abortLoading.load(std::memory_order_relaxed);)
+        {
+            const Key k = fileData[order[i]].key;
+
+            moves.clear();
+            for (; i < expCount && fileData[order[i]].key == k; ++i)
+            {
+                const Current::ExpEntry& e = fileData[order[i]];
+                moves.emplace_back(e.move, e.value, e.depth, e.count);
             }
 
-            if (!exp2->next)
+            // Keys 0 and -1 are reserved by the map
+            if (k && k != (Key) -1)
+                duplicateMoves += link_entries(k, moves.data(), moves.size());
+        }
+
+        return duplicateMoves;
+    }
+
+#ifndef _WIN32
+    // Links the whole entries appended to the experience file after the part already
+    // linked, 'size' being the current size of the file. Returns the number of moves.
+    // If the tail cannot be read, the file is marked as unlinked so that the next
+    // refresh() reloads it.
+    usize link_tail(const ExpFileLock& lock, const usize size) {
+        const usize expCount = (size - _ingested) / sizeof(Current::ExpEntry);
+
+        if (!expCount)
+            return 0;
+
+        const usize length   = expCount * sizeof(Current::ExpEntry);
+        auto*       fileData = static_cast<Current::ExpEntry*>(malloc(length));
+
+        if (!fileData || !lock.read_at((char*) fileData, length, _ingested))
+        {
+            free(fileData);
+            _ingested = _fileId = 0;
+            return 0;
+        }
+
+        _duplicateMoves += link_file_entries(fileData, expCount);
+        _fileMoves += expCount;
+        _ingested += length;
+
+        free(fileData);
+
+        return expCount;
+    }
+
+    // Appends the moves learnt while playing to the experience file in one write
+    // under an exclusive lock. The entries appended by other engines since the last
+    // refresh are linked first, so that the file stays linked up to its end.
+    bool _append(const std::string& fn) {
+        std::vector<char> writeBuffer;
+
+        for (auto& newExp : {_newPvExp, _newMultiPvExp})
+            for (const NewExpEntry& newEntry : newExp)
             {
-                exp2->next = exp;
-                return true;
+                if (newEntry.exp.depth < MinDepth)
+                    continue;
+
+                alignas(Current::ExpEntry) char data[sizeof(Current::ExpEntry)];
+                to_file_entry(newEntry.key, newEntry.exp, data);
+                writeBuffer.insert(writeBuffer.end(), data, data + sizeof(Current::ExpEntry));
             }
 
-            exp2 = exp2->next;
-        } while (true);
+        std::lock_guard   lg(_fileMutex);
+        const ExpFileLock lock(Utility::map_path(fn), true);
+        usize             size;
+        u64               id;
+
+        if (!lock.is_open() || !lock.stat(size, id))
+        {
+            sync_cout << "info string Failed to open experience file [" << fn << "] for writing"
+                      << sync_endl;
+            return false;
+        }
+
+        // If this is a new file then we need to write the signature first
+        const std::string signature = Current::ExperienceSignature;
+
+        if (size == 0)
+            writeBuffer.insert(writeBuffer.begin(), signature.begin(), signature.end());
+        else if (id == _fileId && size >= _ingested)
+            link_tail(lock, size);
+
+        if (!lock.append(writeBuffer.data(), writeBuffer.size()))
+        {
+            sync_cout << "info string Failed to save experience entry to experience file [" << fn
+                      << "]" << sync_endl;
+            return false;
+        }
+
+        // Our own entries are already linked, unless the file has been replaced
+        if (size == 0 || (id == _fileId && size == _ingested))
+        {
+            _ingested = size + writeBuffer.size();
+            _fileId   = id;
+        }
+
+        _fileMoves += (writeBuffer.size() - (size == 0 ? signature.length() : 0))
+                    / sizeof(Current::ExpEntry);
+        _duplicateMoves += _newDuplicates;
 
-        // Should never reach here!
-        __builtin_unreachable();
+        sync_cout << "info string Saved " << _newPvExp.size() << " PV and "
+                  << _newMultiPvExp.size() << " MultiPV entries to experience file: " << fn
+                  << sync_endl;
+
+        clear_new_exp();
+
+        return true;
     }
+#endif
 
     bool _load(const std::string& fn) {
+#ifndef _WIN32
+        // Keep concurrent writers from appending while the entries are being read
+        std::optional<ExpFileLock> lock;
+        lock.emplace(Utility::map_path(fn), false);
+#endif
+
         std::ifstream in(Utility::map_path(fn), std::ios::in | std::ios::binary | std::ios::ate);
 
         if (!in.is_open())
@@ -547,13 +880,13 @@ class ExperienceData {
             sync_cout << "info string Importing experience version (" << reader->get_version()
                       << ") from file [" << fn << "]" << sync_endl;
 
-        // Allocate buffer for ExpEntryEx data
+        // Allocate buffer for the file entries
         const usize expCount = reader->entries_count();
-        auto*       expData  = (ExpEntryEx*) malloc(expCount * sizeof(ExpEntryEx));
+        auto* fileData = static_cast<Current::ExpEntry*>(malloc(expCount * sizeof(Current::ExpEntry)));
 
-        if (!expData)
+        if (!fileData)
         {
-            std::cerr << "info string Failed to allocate " << expCount * sizeof(ExpEntryEx)
+            std::cerr << "info string Failed to allocate " << expCount * sizeof(Current::ExpEntry)
                       << " bytes for experience data from file [" << fn << "]" << std::endl;
             return false;
         }
@@ -561,38 +894,54 @@ class ExperienceData {
         // Few variables to be used for statistical information
         const usize prevPosCount = _mainExp.size();
 
-        // Load experience entries
-        usize       duplicateMoves = 0;
-        ExpEntryEx* exp            = expData;
-
-        for (usize i = 0; i < expCount; ++i, ++exp)
+        // Read experience entries
+        for (usize i = 0; i < expCount; ++i)
         {
             if (_abortLoading.load(std::memory_order_relaxed))
-                break;
-
-            // Prepare to read
-            exp->next = nullptr;
+            {
+                free(fileData);
+                return false;
+            }
 
-            // Read
-            if (!reader->read(in, exp))
+            if (!reader->read(in, &fileData[i]))
             {
                 sync_cout << "info string Failed to read experience entry #" << i + 1 << " of "
                           << expCount << sync_endl;
 
-                delete expData;
+                free(fileData);
                 return false;
             }
-
-            // Merge
-            if (!link_entry(exp))
-                duplicateMoves++;
         }
 
         // Close input file
         in.close();
 
-        // Add buffer to vector so that it will be released later
-        _expData.push_back(expData);
+#ifndef _WIN32
+        // Entries appended from now on are linked by refresh()
+        if (reader->get_version() == Current::ExperienceVersion && lock->is_open()
+            && lock->stat(_ingested, _fileId))
+            _ingested = inSize;
+
+        // Linking the entries and upgrading the file do not need the lock
+        lock.reset();
+#endif
+
+        // Link experience entries, one block per position
+        if (!reserve(expCount))
+        {
+            std::cerr << "info string Failed to allocate " << expCount * sizeof(ExpEntryEx)
+                      << " bytes for experience data from file [" << fn << "]" << std::endl;
+
+            free(fileData);
+            return false;
+        }
+
+        const usize duplicateMoves = link_file_entries(fileData, expCount);
+
+        _fileMoves += expCount;
+        _duplicateMoves += duplicateMoves;
+
+        free(fileData);
 
         // Stop if aborted
         if (_abortLoading.load(std::memory_order_relaxed))
@@ -629,7 +978,12 @@ class ExperienceData {
         return true;
     }
 
-    bool _save(const std::string& fn, const bool saveAll) {
+    bool _save(const std::string& fn, const bool saveAll, const bool report = true) {
+#ifndef _WIN32
+        if (!saveAll)
+            return _append(fn);
+#endif
+
         std::fstream out;
         out.open(Utility::map_path(fn), std::ios::out | std::ios::binary | std::ios::app);
 
@@ -664,10 +1018,11 @@ class ExperienceData {
         std::vector<char> writeBuffer;
         writeBuffer.reserve(WriteBufferSize);
 
-        auto write_entry = [&](const Current::ExpEntry* exp, const bool force) -> bool {
+        auto write_entry = [&](const Key k, const ExpEntryEx* exp, const bool force) -> bool {
             if (exp)
             {
-                const char* data = reinterpret_cast<const char*>(exp);
+                alignas(Current::ExpEntry) char data[sizeof(Current::ExpEntry)];
+                to_file_entry(k, *exp, data);
                 writeBuffer.insert(writeBuffer.end(), data, data + sizeof(Current::ExpEntry));
             }
 
@@ -689,45 +1044,40 @@ class ExperienceData {
             usize allMoves     = 0;
             usize allPositions = 0;
 
-            for (ExpEntryEx* expEx : _newPvExp)
-                link_entry(expEx);
-
-            for (ExpEntryEx* expEx : _newMultiPvExp)
-                link_entry(expEx);
-
+            // The moves learnt while playing are already linked
             for (auto& x : _mainExp)
             {
                 allPositions++;
-                ExpEntryEx* exp = x.second;
+
+                // The moves of a position are contiguous, the last one is flagged
+                ExpEntryEx* const first = x.second;
+                ExpEntryEx*       end   = first;
+
+                while (!end->last)
+                    ++end;
+
+                ++end;
 
                 // Scale counts
-                u16         maxCount = std::numeric_limits<u8>::min();
-                ExpEntryEx* exp1     = exp;
+                u16 maxCount = std::numeric_limits<u8>::min();
 
-                while (exp1)
-                {
-                    maxCount = std::max(maxCount, exp1->count);
-                    exp1     = exp1->next;
-                }
+                for (ExpEntryEx* exp = first; exp != end; ++exp)
+                    maxCount = std::max(maxCount, exp->count);
 
                 // Scale down
                 const u16 scale = 1 + maxCount / 128;
-                exp1            = exp;
 
-                while (exp1)
-                {
-                    exp1->count = std::max(exp1->count / scale, 1);
-                    exp1        = exp1->next;
-                }
+                for (ExpEntryEx* exp = first; exp != end; ++exp)
+                    exp->count = std::max(exp->count / scale, 1);
 
                 // Save
-                while (exp)
+                for (const ExpEntryEx* exp = first; exp != end; ++exp)
                 {
                     if (exp->depth >= MinDepth)
                     {
                         allMoves++;
 
-                        if (!write_entry(exp, false))
+                        if (!write_entry(x.first, exp, false))
                         {
                             sync_cout
                               << "info string Failed to save experience entry to experience file ["
@@ -735,24 +1085,26 @@ class ExperienceData {
                             return false;
                         }
                     }
-
-                    exp = exp->next;
                 }
             }
 
-            sync_cout << "info string Saved " << allPositions << " position(s) and " << allMoves
-                      << " moves to experience file: " << fn << sync_endl;
+            if (report)
+                sync_cout << "info string Saved " << allPositions << " position(s) and "
+                          << allMoves << " moves to experience file: " << fn << sync_endl;
+
+            _fileMoves      = allMoves;
+            _duplicateMoves = 0;
         }
         else
         {
             for (auto& newExp : {_newPvExp, _newMultiPvExp})
             {
-                for (const ExpEntryEx* exp : newExp)
+                for (const NewExpEntry& newEntry : newExp)
                 {
-                    if (exp->depth < MinDepth)
+                    if (newEntry.exp.depth < MinDepth)
                         continue;
 
-                    if (!write_entry(exp, false))
+                    if (!write_entry(newEntry.key, &newEntry.exp, false))
                     {
                         sync_cout
                           << "info string Failed to save experience entry to experience file ["
@@ -768,7 +1120,18 @@ class ExperienceData {
         }
 
         //Flush buffer
-        write_entry(nullptr, true);
+        write_entry(0, nullptr, true);
+        out.close();
+
+#ifndef _WIN32
+        // The new file holds all the linked moves
+        if (saveAll)
+        {
+            const ExpFileLock lock(Utility::map_path(fn), false);
+            if (!lock.is_open() || !lock.stat(_ingested, _fileId))
+                _ingested = _fileId = 0;
+        }
+#endif
 
         //Clear new moves
         clear_new_exp();
@@ -776,6 +1139,138 @@ class ExperienceData {
         return true;
     }
 
+#ifndef _WIN32
+    // Rewrites the experience file without duplicate moves, like defrag does, from
+    // copies of the file read by this thread, so that neither the search nor the
+    // loading are blocked. Each copy only holds the positions of one key range, see
+    // CompactionParts. The entries appended meanwhile are copied at the end of the
+    // temporary file before it atomically replaces the experience file. The temporary
+    // file is named after the process, since other engines may compact the same file.
+    void _compact() {
+    #ifdef __linux__
+        setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)), 19);
+    #endif
+
+        const std::string fn      = Utility::map_path(_filename);
+        const std::string tempFn  = fn + ".tmp." + std::to_string(getpid());
+        usize             oldSize = 0, newSize = 0;
+        u64               id;
+
+        sync_cout << "info string Compacting experience file: " << _filename << sync_endl;
+
+        // Compact the part of the file we have linked, the rest is followed as usual.
+        // That part is never rewritten, the file is only replaced, so it can be read
+        // without the lock.
+        usize compactedSize;
+        u64   compactedId;
+
+        {
+            std::lock_guard lg(_fileMutex);
+
+            compactedSize = _ingested;
+            compactedId   = _fileId;
+        }
+
+        const int   fd = open(fn.c_str(), O_RDONLY);
+        struct stat compacted;
+
+        bool ok = fd != -1 && fstat(fd, &compacted) == 0
+               && ((u64(compacted.st_dev) << 32) ^ u64(compacted.st_ino)) == compactedId;
+
+        remove(tempFn.c_str());
+
+        const usize first = std::string(Current::ExperienceSignature).length();
+        const usize chunkLength =
+          WriteBufferSize / sizeof(Current::ExpEntry) * sizeof(Current::ExpEntry);
+        auto* fileData = static_cast<Current::ExpEntry*>(malloc(chunkLength));
+
+        ok = ok && fileData;
+
+        for (usize part = 0; ok && part < CompactionParts; ++part)
+        {
+            ExperienceData data;
+
+            for (usize offset = first; ok && offset < compactedSize;)
+            {
+                const ssize_t r = pread(fd, fileData, std::min(compactedSize - offset, chunkLength),
+                                        off_t(offset));
+
+                ok = r > 0 && usize(r) % sizeof(Current::ExpEntry) == 0
+                  && !_abortCompaction.load(std::memory_order_relaxed);
+
+                if (!ok)
+                    break;
+
+                // Keep the entries of this key range
+                usize expCount = 0;
+                for (usize i = 0; i < usize(r) / sizeof(Current::ExpEntry); ++i)
+                    if (fileData[i].key % CompactionParts == part)
+                        std::memmove(static_cast<void*>(&fileData[expCount++]), &fileData[i],
+                                     sizeof(Current::ExpEntry));
+
+                data.link_file_entries(fileData, expCount);
+                offset += usize(r);
+            }
+
+            ok = ok && data._save(tempFn, true, false)
+              && !_abortCompaction.load(std::memory_order_relaxed);
+        }
+
+        free(fileData);
+
+        if (fd != -1)
+            close(fd);
+
+        if (ok)
+        {
+            std::lock_guard   lg(_fileMutex);
+            const ExpFileLock lock(fn, true);
+
+            ok = lock.is_open() && lock.stat(oldSize, id) && id == compactedId && id == _fileId
+              && oldSize >= _ingested;
+
+            // Copy the entries appended while compacting
+            if (ok && oldSize > compactedSize)
+            {
+                std::vector<char> tail(oldSize - compactedSize);
+                std::ofstream     out(tempFn, std::ios::out | std::ios::binary | std::ios::app);
+
+                ok = lock.read_at(tail.data(), tail.size(), compactedSize)
+                  && out.write(tail.data(), std::streamsize(tail.size())) && out.flush();
+            }
+
+            struct stat st;
+            ok = ok && ::stat(tempFn.c_str(), &st) == 0 && rename(tempFn.c_str(), fn.c_str()) == 0;
+
+            // Keep following the file, which now starts with the compacted entries
+            if (ok)
+            {
+                newSize = usize(st.st_size);
+
+                _ingested = newSize - (oldSize - _ingested);
+                _fileId   = (u64(st.st_dev) << 32) ^ u64(st.st_ino);
+
+                _fileMoves      = (newSize - std::string(Current::ExperienceSignature).length())
+                           / sizeof(Current::ExpEntry);
+                _duplicateMoves = 0;
+            }
+        }
+
+        if (!ok)
+        {
+            remove(tempFn.c_str());
+
+            if (!_abortCompaction.load(std::memory_order_relaxed))
+                sync_cout << "info string Could not compact experience file: " << _filename
+                          << sync_endl;
+            return;
+        }
+
+        sync_cout << "info string Compacted experience file [" << _filename << "] from "
+                  << oldSize << " to " << newSize << " bytes" << sync_endl;
+    }
+#endif
+
    public:
     ExperienceData() {
         _loading = false;
@@ -897,34 +1392,79 @@ class ExperienceData {
         }
     }
 
+    // Links the entries appended to the experience file by other engines since the
+    // last refresh. Returns false if the file has been replaced or truncated since
+    // it was loaded, in which case it has to be reloaded.
+    bool refresh() {
+        wait_for_load_finished();
+
+#ifndef _WIN32
+        std::lock_guard   lg(_fileMutex);
+        const ExpFileLock lock(Utility::map_path(_filename), false);
+        usize             size;
+        u64               id;
+
+        if (!lock.is_open() || !lock.stat(size, id)
+            || size <= std::string(Current::ExperienceSignature).length())
+            return true;
+
+        if (id != _fileId || size < _ingested)
+            return false;
+
+        const usize expCount = link_tail(lock, size);
+
+        if (!_fileId)
+            return false;
+
+        if (expCount)
+            sync_cout << "info string " << _filename << " -> Total new moves: " << expCount
+                      << ". Total positions: " << _mainExp.size() << sync_endl;
+#endif
+
+        return true;
+    }
+
+    // Starts compacting the experience file in the background if more than 'threshold'
+    // percent of its moves are duplicates, and it is not being compacted already.
+    void compact(const int threshold) {
+#ifndef _WIN32
+        if (!threshold || _compacting.load(std::memory_order_acquire))
+            return;
+
+        if (_compactorThread.joinable())
+            _compactorThread.join();
+
+        {
+            std::lock_guard lg(_fileMutex);
+
+            if (!_fileId || 100 * _duplicateMoves <= usize(threshold) * _fileMoves)
+                return;
+        }
+
+        _compacting.store(true, std::memory_order_relaxed);
+        _compactorThread = std::thread([this]() {
+            _compact();
+            _compacting.store(false, std::memory_order_release);
+        });
+#endif
+    }
+
     [[nodiscard]] const ExpEntryEx* probe(const Key k) const {
         ExpConstIterator itr = _mainExp.find(k);
         if (itr == _mainExp.end())
             return nullptr;
 
-        assert(itr->second->key == k);
-
         return itr->second;
     }
 
     void add_pv_experience(const Key k, const Move m, const Value v, const Depth d) {
-        auto* exp = new ExpEntryEx(k, m, v, d, 1);
-
-        if (exp)
-        {
-            _newPvExp.emplace_back(exp);
-            link_entry(exp);
-        }
+        _newPvExp.push_back({k, ExpEntryEx(m, v, d, 1)});
+        _newDuplicates += link_entries(k, &_newPvExp.back().exp, 1);
     }
 
     void add_multipv_experience(const Key k, const Move m, const Value v, const Depth d) {
-        auto* exp = new ExpEntryEx(k, m, v, d, 1);
-
-        if (exp)
-        {
-            _newMultiPvExp.emplace_back(exp);
-            link_entry(exp);
-        }
+        _newMultiPvExp.push_back({k, ExpEntryEx(m, v, d, 1)});
+        _newDuplicates += link_entries(k, &_newMultiPvExp.back().exp, 1);
     }
 };
 
@@ -946,6 +1486,21 @@ void init() {
         return;
     }
 
+    // Use the experience of a local server instead of loading the file
+    const std::string server = Options["Experience Server"];
+
+    if (!server.empty() && server != "<empty>")
+    {
+        unload();
+
+        if (Server::connect(server))
+            return;
+
+        sync_cout << "info string Loading the experience file instead" << sync_endl;
+    }
+    else
+        Server::disconnect();
+
     const std::string filename = Options["Experience File"];
 
     if (currentExperience)
@@ -963,29 +1518,47 @@ void init() {
 
 bool enabled() { return experienceEnabled; }
 
+bool is_remote() { return experienceEnabled && !currentExperience && Server::connected(); }
+
 void unload() {
     save();
+    Server::disconnect();
 
     delete currentExperience;
     currentExperience = nullptr;
 }
 
 void save() {
-    if (!currentExperience || !currentExperience->has_new_exp()
-        || static_cast<bool>(Options["Experience Readonly"]))
+    if (UCI::snapshot()->expReadonly)
+        return;
+
+    if (Server::connected())
+        Server::flush();
+
+    if (!currentExperience || !currentExperience->has_new_exp())
         return;
 
     currentExperience->save(currentExperience->filename(), false, false);
 }
 
 const ExpEntryEx* probe(const Key k) {
+    INSTRUMENT(INS_EXP_PROBE);
     assert(experienceEnabled);
     if (!currentExperience)
-        return nullptr;
+        return Server::connected() ? Server::probe(k) : nullptr;
 
     return currentExperience->probe(k);
 }
 
+void prefetch(Position& pos) {
+    if (experienceEnabled && !currentExperience)
+        Server::prefetch(pos);
+}
+
+void pause_lookups() { Server::pause_lookups(); }
+
+void resume_lookups() { Server::resume_lookups(); }
+
 const ExpEntryEx* find_best_entry(const Key k) {
     const ExpEntryEx* bestEntry    = nullptr;
     const ExpEntryEx* currentEntry = probe(k);
@@ -995,19 +1568,46 @@ const ExpEntryEx* find_best_entry(const Key k) {
         if (!bestEntry || currentEntry->compare(bestEntry) > 0)
             bestEntry = currentEntry;
 
-        currentEntry = currentEntry->next;
+        currentEntry = currentEntry->next();
     }
 
     return bestEntry;
 }
 
 void wait_for_loading_finished() {
+    Server::wait_for_prefetch();
+
     if (!currentExperience)
         return;
 
     currentExperience->wait_for_load_finished();
 }
 
+void refresh() {
+    if (!currentExperience)
+        return;
+
+    if (currentExperience->refresh())
+    {
+        const auto opts = UCI::snapshot();
+
+        if (!opts->expReadonly)
+            currentExperience->compact(opts->expCompaction);
+
+        return;
+    }
+
+    const std::string filename = currentExperience->filename();
+
+    sync_cout << "info string The experience file [" << filename
+              << "] has been replaced, reloading it" << sync_endl;
+
+    unload();
+
+    currentExperience = new ExperienceData();
+    currentExperience->load(filename, true);
+}
+
 // Defrag command:
 // Format:  defrag [filename]
 // Example: defrag C:\Path to\Experience\file.exp
@@ -1096,6 +1696,181 @@ void merge(const int argc, char* argv[]) {
     exp.save(targetFilename, true, false);
 }
 
+// Expserver command:
+// Format:  expserver <socket> [filename]
+// Example: expserver /tmp/hypnos-exp.sock C:\Path to\Experience\file.exp
+// Note:    Serves the experience file to the engines whose 'Experience Server' option is 'socket'.
+//          'filename' is optional. If omitted, then the 'Experience File' option will be used.
+//          The new moves are appended to the file as they are received. Type 'quit' to stop.
+void serve(const int argc, char* argv[]) {
+    // Make sure experience has finished loading
+    wait_for_loading_finished();
+
+    if (argc < 1 || argc > 2)
+    {
+        sync_cout << "info string Error : Incorrect expserver command" << sync_endl;
+        sync_cout << "info string Syntax: expserver <socket> [filename]" << sync_endl;
+        return;
+    }
+
+#ifndef _WIN32
+    const std::string socketPath = Utility::unquote(argv[0]);
+    const std::string filename   = Utility::map_path(
+      argc == 2 ? Utility::unquote(argv[1]) : std::string(Options["Experience File"]));
+
+    auto exp = std::make_unique<ExperienceData>();
+    exp->load(filename, true);
+
+    // Listen
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+
+    const int listenFd =
+      socketPath.size() < sizeof(addr.sun_path) ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+
+    if (listenFd != -1)
+    {
+        socketPath.copy(addr.sun_path, socketPath.size());
+        unlink(socketPath.c_str());
+    }
+
+    if (listenFd == -1 || bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || listen(listenFd, SOMAXCONN) != 0)
+    {
+        sync_cout << "info string Could not listen on socket: " << socketPath << sync_endl;
+
+        if (listenFd != -1)
+            close(listenFd);
+
+        return;
+    }
+
+    sync_cout << "info string Serving experience file [" << filename << "] on socket: "
+              << socketPath << sync_endl;
+
+    // Serve one request of a client, returns false if the client is gone
+    std::vector<Key>             keys;
+    std::vector<u32>             counts;
+    std::vector<ExpEntryEx>      moves;
+    std::vector<Server::AddItem> items;
+
+    auto serve_request = [&](const int fd) -> bool {
+        Server::RequestHeader header;
+
+        if (!Server::recv_all(fd, &header, sizeof(header)) || header.count > Server::MaxItems)
+            return false;
+
+        if (header.type == Server::PROBE)
+        {
+            keys.resize(header.count);
+            counts.clear();
+            moves.clear();
+
+            if (!Server::recv_all(fd, keys.data(), keys.size() * sizeof(Key)))
+                return false;
+
+            for (const Key k : keys)
+            {
+                const usize first = moves.size();
+
+                for (const ExpEntryEx* e = exp->probe(k); e; e = e->next())
+                    moves.push_back(*e);
+
+                counts.push_back(u32(moves.size() - first));
+            }
+
+            return Server::send_all(fd, counts.data(), counts.size() * sizeof(u32))
+                && Server::send_all(fd, moves.data(), moves.size() * sizeof(ExpEntryEx));
+        }
+
+        if (header.type == Server::ADD_PV || header.type == Server::ADD_MULTIPV)
+        {
+            items.resize(header.count);
+
+            if (!Server::recv_all(fd, items.data(), items.size() * sizeof(Server::AddItem)))
+                return false;
+
+            for (const Server::AddItem& item : items)
+            {
+                // Keys 0 and -1 are reserved by the map
+                if (!item.key || item.key == (Key) -1)
+                    continue;
+
+                if (header.type == Server::ADD_PV)
+                    exp->add_pv_experience(item.key, item.exp.move, (Value) item.exp.value,
+                                           (Depth) item.exp.depth);
+                else
+                    exp->add_multipv_experience(item.key, item.exp.move, (Value) item.exp.value,
+                                                (Depth) item.exp.depth);
+            }
+
+            exp->save(filename, false, false);
+            return true;
+        }
+
+        return false;
+    };
+
+    // Lines buffered by stdio are not seen by poll(), so read stdin unbuffered. It has
+    // not been read yet, as the server is only started from the command line.
+    setvbuf(stdin, nullptr, _IONBF, 0);
+
+    std::vector<pollfd> fds{{STDIN_FILENO, POLLIN, 0}, {listenFd, POLLIN, 0}};
+    bool                running = true;
+
+    while (running)
+    {
+        // Link the moves appended to the file by other engines while idle
+        if (poll(fds.data(), fds.size(), 1000) <= 0)
+        {
+            if (!exp->refresh())
+            {
+                exp = std::make_unique<ExperienceData>();
+                exp->load(filename, true);
+            }
+
+            exp->compact(UCI::snapshot()->expCompaction);
+            continue;
+        }
+
+        for (usize i = fds.size(); i-- > 0;)
+        {
+            if (!fds[i].revents)
+                continue;
+
+            if (fds[i].fd == STDIN_FILENO)
+            {
+                std::string cmd;
+                running = std::getline(std::cin, cmd) && cmd != "quit";
+            }
+            else if (fds[i].fd == listenFd)
+            {
+                const int clientFd = accept(listenFd, nullptr, nullptr);
+
+                if (clientFd != -1)
+                {
+                    Server::set_io_timeout(clientFd);
+                    fds.push_back({clientFd, POLLIN, 0});
+                }
+            }
+            else if (!serve_request(fds[i].fd))
+            {
+                close(fds[i].fd);
+                fds.erase(fds.begin() + i);
+            }
+        }
+    }
+
+    for (usize i = 1; i < fds.size(); ++i)
+        close(fds[i].fd);
+
+    unlink(socketPath.c_str());
+#else
+    sync_cout << "info string Error : The experience server is not supported on this platform"
+              << sync_endl;
+#endif
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Convert compact PGN data to experience entries
 //
@@ -1595,14 +2370,14 @@ void show_exp(Position& pos, const bool extended) {
         return;
     }
 
-    const int evalImportance = (int) Options["Experience Book Eval Importance"];
+    const int evalImportance = UCI::snapshot()->expBookEvalImportance;
     std::vector<std::pair<const ExpEntryEx*, int>> quality;
     const ExpEntryEx*                              temp = expEx;
 
     while (temp)
     {
         quality.emplace_back(temp, temp->quality(pos, evalImportance).first);
-        temp = temp->next;
+        temp = temp->next();
     }
 
     //Sort experience moves based on quality
@@ -1620,7 +2395,7 @@ void show_exp(Position& pos, const bool extended) {
         std::cout << std::setw(2) << std::setfill(' ') << std::left << ++expCount << ": "
                   << std::setw(5) << std::setfill(' ') << std::left
                   << UCI::move(pr.first->move, pos.is_chess960()) << ", depth: " << std::setw(2)
-                  << std::setfill(' ') << std::left << pr.first->depth << ", eval: " << std::setw(6)
+                  << std::setfill(' ') << std::left << int(pr.first->depth) << ", eval: " << std::setw(6)
                   << std::setfill(' ') << std::left << UCI::value(pr.first->value);
 
         if (extended)
@@ -1638,7 +2413,7 @@ void show_exp(Position& pos, const bool extended) {
 
         std::cout << std::endl;
 
-        expEx = expEx->next;
+        expEx = expEx->next();
     }
 
     std::cout << sync_endl;
@@ -1652,7 +2427,12 @@ bool is_learning_paused() { return learningPaused; }
 
 void add_pv_experience(const Key k, const Move m, const Value v, const Depth d) {
     if (!currentExperience)
+    {
+        if (Server::connected())
+            Server::add(k, ExpEntryEx(m, v, d, 1), true);
+
         return;
+    }
 
     assert((bool) Options["Experience Readonly"] == false);
 
@@ -1661,7 +2441,12 @@ void add_pv_experience(const Key k, const Move m, const Value v, const Depth d)
 
 void add_multipv_experience(const Key k, const Move m, const Value v, const Depth d) {
     if (!currentExperience)
+    {
+        if (Server::connected())
+            Server::add(k, ExpEntryEx(m, v, d, 1), false);
+
         return;
+    }
 
     assert((bool) Options["Experience Readonly"] == false);
 
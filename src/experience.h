@@ -19,12 +19,18 @@
 #ifndef EXPERIENCE_H_INCLUDED
 #define EXPERIENCE_H_INCLUDED
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
 #include "types.h"
 
 //using namespace std;
 using u8    = std::uint8_t;
 using u16   = std::uint16_t;
 using u32   = std::uint32_t;
+using u64   = std::uint64_t;
 using usize = std::size_t;
 
 namespace Experience {
@@ -157,71 +163,105 @@ static_assert(sizeof(ExpEntry) == 24);
 
 namespace Current = V2;
 
-// Experience structure
-struct ExpEntryEx: Current::ExpEntry {
-    ExpEntryEx* next = nullptr;
+// In memory, the moves of a position are stored in a block of ExpEntryEx sorted
+// by compare() in descending order, and the key is only stored once in the map
+// of positions. ExpEntryEx keeps all the data of a file entry for depths below
+// 256 and values within 16 bits, so the file round-trips without any loss.
+struct ExpEntryEx {
+    ExpMove move;   // 2 bytes
+    int16_t value;  // 2 bytes
+    u16     count;  // 2 bytes
+    u8      depth;  // 1 byte
+    u8      last;   // 1 byte (Last move of the position)
+
+    ExpEntryEx() = default;
+
+    explicit ExpEntryEx(const ExpMove m, const ExpValue v, const ExpDepth d, const u16 c) :
+        move(m),
+        value(int16_t(std::clamp<int>(v, INT16_MIN, INT16_MAX))),
+        count(c),
+        depth(u8(std::clamp<int>(d, 0, UINT8_MAX))),
+        last(true) {}
+
+    [[nodiscard]] const ExpEntryEx* next() const { return last ? nullptr : this + 1; }
+
+    // Same merging rules as Current::ExpEntry::merge()
+    void merge(const ExpEntryEx& exp) {
+        assert(move == exp.move);
+
+        count = static_cast<u16>(std::min<u32>(count + exp.count, std::numeric_limits<u16>::max()));
+
+        if (depth == exp.depth)
+            value = int16_t((value + exp.value) / 2);
+        else if (depth < exp.depth)
+        {
+            value = exp.value;
+            depth = exp.depth;
+        }
+    }
 
-                ExpEntryEx()                      = delete;
-                ExpEntryEx(const ExpEntryEx& exp) = delete;
-    ExpEntryEx& operator=(const ExpEntryEx& exp)  = delete;
+    // Same ordering as Current::ExpEntry::compare()
+    [[nodiscard]] int compare(const ExpEntryEx* exp) const {
+        static constexpr int DepthScale = 10;
+        static constexpr int CountScale = 3;
 
-    explicit
-    ExpEntryEx(const ExpKey k, const ExpMove m, const ExpValue v, const ExpDepth d, const u8 c) :
-        Current::ExpEntry(k, m, v, d, c) {}
+        auto scaledValue = [](const int v, const int d, const int c) -> int {
+            return v * std::max(d / DepthScale, 1) * std::max(c / CountScale, 1);
+        };
 
-    [[nodiscard]] ExpEntryEx* find(const ExpMove m) const {
-        auto* exp = const_cast<ExpEntryEx*>(this);
+        int v = scaledValue(value, depth, count) - scaledValue(exp->value, exp->depth, exp->count);
 
-        do
-        {
-            if (exp->move == m)
-                return exp;
+        if (v)
+            return v;
 
-            exp = exp->next;
-        } while (exp);
+        if ((v = count - exp->count) != 0)
+            return v;
 
-        return nullptr;
+        return depth - exp->depth;
     }
 
-    [[nodiscard]] ExpEntryEx* find(const ExpMove mv, const ExpDepth minDepth) const {
-        auto* temp = const_cast<ExpEntryEx*>(this);
-
-        do
-        {
-            if (temp->move == mv)
-            {
-                if (temp->depth < minDepth)
-                    temp = nullptr;
-
-                break;
-            }
+    [[nodiscard]] const ExpEntryEx* find(const ExpMove m) const {
+        for (const ExpEntryEx* exp = this; exp; exp = exp->next())
+            if (exp->move == m)
+                return exp;
 
-            temp = temp->next;
-        } while (temp);
+        return nullptr;
+    }
 
-        return temp;
+    [[nodiscard]] const ExpEntryEx* find(const ExpMove mv, const ExpDepth minDepth) const {
+        const ExpEntryEx* exp = find(mv);
+        return exp && exp->depth >= minDepth ? exp : nullptr;
     }
 
     std::pair<int, bool> quality(Hypnos::Position& pos, int evalImportance) const;
 };
 
+static_assert(sizeof(ExpEntryEx) == 8);
+
 }
 
 namespace Experience {
 
 void init();
 bool enabled();
+bool is_remote();
 
 void unload();
 void save();
 
 void wait_for_loading_finished();
+void refresh();
 
 const ExpEntryEx* probe(ExpKey k);
 const ExpEntryEx* find_best_entry(ExpKey k);
 
+void prefetch(Hypnos::Position& pos);
+void pause_lookups();
+void resume_lookups();
+
 void defrag(int argc, char* argv[]);
 void merge(int argc, char* argv[]);
+void serve(int argc, char* argv[]);
 void show_exp(Hypnos::Position& pos, bool extended);
 void convert_compact_pgn(int argc, char* argv[]);
 
@@ -0,0 +1,357 @@
+/*
+  HypnoS, a UCI chess playing engine derived from Stockfish
+  Copyright (C) 2004-2025 The Stockfish developers (see AUTHORS file)
+
+  HypnoS is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  HypnoS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+    #include <sys/socket.h>
+    #include <sys/time.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+#include "misc.h"
+#include "movegen.h"
+#include "position.h"
+#include "expserver.h"
+
+using namespace Hypnos;
+
+namespace Experience::Server {
+
+namespace {
+
+// Number of positions kept in the cache between two prefetches
+constexpr usize CacheSize = 1 << 16;
+
+struct CachedPosition {
+    std::vector<ExpEntryEx> moves;  // Empty if the server has no experience
+    u64                     lastUse;
+    bool                    stale;  // New moves have been sent since it was fetched
+};
+
+std::atomic<int> serverFd{-1};
+std::string      serverPath;
+
+// The cache is only modified under the mutex while lookups are not paused. Lookups
+// are paused during the parallel search, which reads the cache without locking and
+// doesn't fetch missing positions.
+std::mutex                              cacheMutex;
+std::unordered_map<Key, CachedPosition> cache;
+std::atomic<bool>                       lookupsPaused{false};
+u64                                     useClock = 0;
+std::thread                             prefetcher;
+std::mutex                              prefetcherMutex;  // Joined by the UCI and main threads
+std::vector<AddItem>                    newPvExp, newMultiPvExp;
+
+void close_connection() {
+#ifndef _WIN32
+    const int fd = serverFd.exchange(-1);
+    if (fd != -1)
+        close(fd);
+#endif
+}
+
+void connection_lost() {
+    close_connection();
+    sync_cout << "info string Lost connection to experience server: " << serverPath << sync_endl;
+}
+
+// Fetches the moves of 'keys' into the cache. The cache mutex must be held.
+bool fetch(const std::vector<Key>& keys) {
+    const int fd = serverFd.load(std::memory_order_relaxed);
+
+    if (fd == -1 || keys.empty())
+        return fd != -1;
+
+    const RequestHeader header{PROBE, u32(keys.size())};
+    std::vector<u32>    counts(keys.size());
+
+    if (!send_all(fd, &header, sizeof(header))
+        || !send_all(fd, keys.data(), keys.size() * sizeof(Key))
+        || !recv_all(fd, counts.data(), counts.size() * sizeof(u32)))
+    {
+        connection_lost();
+        return false;
+    }
+
+    for (usize i = 0; i < keys.size(); ++i)
+    {
+        CachedPosition& cp = cache[keys[i]];
+
+        cp.moves.resize(std::min(counts[i], MaxItems));
+        cp.lastUse = ++useClock;
+        cp.stale   = false;
+
+        if (counts[i] > MaxItems
+            || !recv_all(fd, cp.moves.data(), cp.moves.size() * sizeof(ExpEntryEx)))
+        {
+            cache.erase(keys[i]);
+            connection_lost();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Drops the least recently used positions. Called only when nobody holds a pointer
+// to a cached move, that is when a new position is set up.
+void trim() {
+    if (cache.size() <= CacheSize)
+        return;
+
+    std::vector<std::pair<u64, Key>> uses;
+    uses.reserve(cache.size());
+
+    for (const auto& [k, cp] : cache)
+        uses.emplace_back(cp.lastUse, k);
+
+    const usize drop = cache.size() - CacheSize * 3 / 4;
+    std::nth_element(uses.begin(), uses.begin() + drop, uses.end());
+
+    for (usize i = 0; i < drop; ++i)
+        cache.erase(uses[i].second);
+}
+
+bool send_new_exp(std::vector<AddItem>& items, const RequestType type) {
+    const int fd = serverFd.load(std::memory_order_relaxed);
+
+    if (items.empty() || fd == -1)
+        return true;
+
+    const RequestHeader header{type, u32(items.size())};
+
+    if (!send_all(fd, &header, sizeof(header))
+        || !send_all(fd, items.data(), items.size() * sizeof(AddItem)))
+    {
+        connection_lost();
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+void set_io_timeout(const int fd) {
+#ifndef _WIN32
+    const timeval tv{IoTimeout / 1000, IoTimeout % 1000 * 1000};
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+}
+
+bool send_all(const int fd, const void* data, usize length) {
+#ifndef _WIN32
+    auto* p = static_cast<const char*>(data);
+
+    while (length)
+    {
+        const ssize_t n = send(fd, p, length, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+
+        p += n;
+        length -= usize(n);
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool recv_all(const int fd, void* data, usize length) {
+#ifndef _WIN32
+    auto* p = static_cast<char*>(data);
+
+    while (length)
+    {
+        const ssize_t n = recv(fd, p, length, 0);
+        if (n <= 0)
+            return false;
+
+        p += n;
+        length -= usize(n);
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool connect(const std::string& path) {
+    disconnect();
+
+#ifndef _WIN32
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+
+    const int fd = path.size() < sizeof(addr.sun_path) ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+
+    if (fd != -1)
+    {
+        path.copy(addr.sun_path, path.size());
+
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+        {
+            set_io_timeout(fd);
+            serverPath = path;
+            serverFd.store(fd);
+
+            sync_cout << "info string Connected to experience server: " << path << sync_endl;
+            return true;
+        }
+
+        close(fd);
+    }
+#endif
+
+    sync_cout << "info string Could not connect to experience server: " << path << sync_endl;
+    return false;
+}
+
+void disconnect() {
+    wait_for_prefetch();
+    flush();
+
+    std::lock_guard lock(cacheMutex);
+
+    close_connection();
+    cache.clear();
+}
+
+bool connected() { return serverFd.load(std::memory_order_relaxed) != -1; }
+
+const ExpEntryEx* probe(const Key k) {
+    if (lookupsPaused.load(std::memory_order_relaxed))
+    {
+        const auto itr = cache.find(k);
+        return itr != cache.end() && !itr->second.moves.empty() ? itr->second.moves.data()
+                                                                : nullptr;
+    }
+
+    std::lock_guard lock(cacheMutex);
+
+    auto itr = cache.find(k);
+
+    if (itr == cache.end() || itr->second.stale)
+    {
+        if (!fetch({k}))
+            return nullptr;
+
+        itr = cache.find(k);
+    }
+    else
+        itr->second.lastUse = ++useClock;
+
+    return itr->second.moves.empty() ? nullptr : itr->second.moves.data();
+}
+
+// Looks up the position and the positions after each legal move in one request,
+// in the background. Probes wait for the request to complete.
+void prefetch(Position& pos) {
+    if (!connected())
+        return;
+
+    wait_for_prefetch();
+
+    std::vector<Key> keys;
+
+    {
+        std::lock_guard lock(cacheMutex);
+
+        trim();
+
+        auto request = [&](const Key k) {
+            const auto itr = cache.find(k);
+
+            if (itr == cache.end() || itr->second.stale)
+                keys.push_back(k);
+            else
+                itr->second.lastUse = ++useClock;
+        };
+
+        request(pos.key());
+
+        StateInfo st;
+        for (const auto& m : MoveList<LEGAL>(pos))
+        {
+            pos.do_move(m, st);
+            request(pos.key());
+            pos.undo_move(m);
+        }
+    }
+
+    if (!keys.empty())
+    {
+        std::lock_guard joinLock(prefetcherMutex);
+
+        prefetcher = std::thread([keys = std::move(keys)]() {
+            std::lock_guard lock(cacheMutex);
+            fetch(keys);
+        });
+    }
+}
+
+void wait_for_prefetch() {
+    std::lock_guard lock(prefetcherMutex);
+
+    if (prefetcher.joinable())
+        prefetcher.join();
+}
+
+void pause_lookups() { lookupsPaused.store(true, std::memory_order_relaxed); }
+
+void resume_lookups() { lookupsPaused.store(false, std::memory_order_relaxed); }
+
+void add(const Key k, const ExpEntryEx& exp, const bool pv) {
+    std::lock_guard lock(cacheMutex);
+
+    (pv ? newPvExp : newMultiPvExp).push_back({k, exp});
+
+    // The server merges the move, so fetch the position again on the next probe
+    const auto itr = cache.find(k);
+    if (itr != cache.end())
+        itr->second.stale = true;
+}
+
+void flush() {
+    std::lock_guard lock(cacheMutex);
+
+    if (newPvExp.empty() && newMultiPvExp.empty())
+        return;
+
+    if (send_new_exp(newPvExp, ADD_PV) && send_new_exp(newMultiPvExp, ADD_MULTIPV))
+        sync_cout << "info string Saved " << newPvExp.size() << " PV and " << newMultiPvExp.size()
+                  << " MultiPV entries to experience server: " << serverPath << sync_endl;
+
+    newPvExp.clear();
+    newMultiPvExp.clear();
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+  HypnoS, a UCI chess playing engine derived from Stockfish
+  Copyright (C) 2004-2025 The Stockfish developers (see AUTHORS file)
+
+  HypnoS is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  HypnoS is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EXPSERVER_H_INCLUDED
+#define EXPSERVER_H_INCLUDED
+
+#include <string>
+
+namespace Hypnos {
+class Position;
+}
+
+#include "experience.h"
+
+// An experience server ('expserver' command) owns one copy of an experience file
+// and serves the engines of the same machine over a Unix domain socket, so that
+// they don't each have to load the whole file. Engines using it keep the moves of
+// the positions they have looked up in a small cache.
+namespace Experience::Server {
+
+// A request is a header followed by 'count' items. Data is sent in the host byte
+// order as the server can only be reached from the same machine.
+enum RequestType : u32 {
+    PROBE       = 1,  // Items are keys
+    ADD_PV      = 2,  // Items are AddItem
+    ADD_MULTIPV = 3   // Items are AddItem
+};
+
+struct RequestHeader {
+    u32 type;
+    u32 count;
+};
+
+struct AddItem {
+    ExpKey     key;
+    ExpEntryEx exp;
+};
+
+static_assert(sizeof(RequestHeader) == 8);
+static_assert(sizeof(AddItem) == 16);
+
+// The reply to a PROBE request is the number of moves of each key, followed by the
+// moves of all the keys in request order. Other requests have no reply.
+constexpr u32 MaxItems = 1 << 20;
+
+// Socket reads and writes fail after this many milliseconds without progress, so
+// that a stalled client is dropped by the server and a hung server is handled by
+// its clients as a lost connection.
+constexpr int IoTimeout = 2000;
+
+void set_io_timeout(int fd);
+bool send_all(int fd, const void* data, usize length);
+bool recv_all(int fd, void* data, usize length);
+
+bool connect(const std::string& path);
+void disconnect();
+bool connected();
+
+const ExpEntryEx* probe(ExpKey k);
+void              prefetch(Hypnos::Position& pos);
+void              wait_for_prefetch();
+void              pause_lookups();
+void              resume_lookups();
+
+void add(ExpKey k, const ExpEntryEx& exp, bool pv);
+void flush();
+
+}
+
+#endif  // #ifndef EXPSERVER_H_INCLUDED
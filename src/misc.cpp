@@ -58,6 +58,7 @@ using fun8_t = bool(*)(HANDLE, BOOL, PTOKEN_PRIVILEGES, DWORD, PTOKEN_PRIVILEGES
 #include <iostream>
 #include <mutex>
 #include <sstream>
+#include <vector>
 #include <string_view>
 #include <stdarg.h>
 #include <bitset>
@@ -301,6 +302,9 @@ std::string compiler_info() {
     compiler += " DEBUG";
   #endif
 
+  compiler += "\nSlider attacks             : ";
+  compiler += Bitboards::sliders_info();
+
   compiler += "\nCompiler __VERSION__ macro : ";
   #ifdef __VERSION__
      compiler += __VERSION__;
@@ -1080,6 +1084,86 @@ void dbg_print() {
 }
 
 
+#ifdef USE_INSTRUMENT
+
+namespace {
+
+// Counter blocks of all threads that ever hit a hook. They are never freed,
+// so the cycles of threads that have since exited are still reported.
+std::mutex                       instrumentMutex;
+std::vector<InstrumentCounters*> instrumentBlocks;
+
+}
+
+InstrumentCounters* instrument_register() {
+
+    std::lock_guard<std::mutex> lk(instrumentMutex);
+    instrumentBlocks.push_back(new InstrumentCounters());
+    return instrumentBlocks.back();
+}
+
+// Must only be called while the search threads are idle
+void instrument_clear() {
+
+    std::lock_guard<std::mutex> lk(instrumentMutex);
+    for (InstrumentCounters* c : instrumentBlocks)
+        *c = InstrumentCounters();
+}
+
+// With 'nodes', the bench node count, the cost of each hook per searched node is
+// reported as well.
+void instrument_print(uint64_t nodes) {
+
+    constexpr const char* Names[INS_POINT_NB] = {
+      "Position::do_move",  "MovePicker::next_move", "MovePicker::score_and_sort",
+      "FeatureTransformer::transform", "Network::propagate", "TT.probe", "Experience::probe",
+      "Tablebases::probe_wdl"};
+
+    uint64_t calls[INS_POINT_NB] = {}, cycles[INS_POINT_NB] = {}, total = 0;
+
+    {
+        std::lock_guard<std::mutex> lk(instrumentMutex);
+        for (InstrumentCounters* c : instrumentBlocks)
+            for (int i = 0; i < INS_POINT_NB; ++i)
+                calls[i] += c->calls[i], cycles[i] += c->cycles[i];
+    }
+
+    for (int i = 0; i < INS_POINT_NB; ++i)
+        total += cycles[i];
+
+    std::ostringstream ss;
+    ss << "\nInstrumentation (" <<
+    #if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+      "TSC cycles"
+    #else
+      "nanoseconds"
+    #endif
+       << ", nested hooks are counted in both)\n";
+
+    for (int i = 0; i < INS_POINT_NB; ++i)
+    {
+        ss << std::left << std::setw(30) << Names[i] << std::right << " calls " << std::setw(12)
+           << calls[i] << " total " << std::setw(14) << cycles[i] << " per call " << std::setw(8)
+           << std::fixed << std::setprecision(1)
+           << (calls[i] ? double(cycles[i]) / calls[i] : 0.0);
+
+        if (nodes)
+            ss << " per node " << std::setw(8) << double(cycles[i]) / nodes;
+
+        ss << " share " << std::setw(5) << (total ? 100.0 * cycles[i] / total : 0.0) << "%\n";
+    }
+
+    std::cerr << ss.str() << std::flush;
+}
+
+#else
+
+void instrument_clear() {}
+void instrument_print(uint64_t) {}
+
+#endif
+
+
 /// Used to serialize access to std::cout to avoid multiple threads writing at
 /// the same time.
 
@@ -40,6 +40,14 @@
     #include <windows.h>
 #endif
 
+#ifdef USE_INSTRUMENT
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #elif defined(__x86_64__) || defined(__i386__)
+        #include <x86intrin.h>
+    #endif
+#endif
+
 #include "types.h"
 
 #define stringify2(x) #x
@@ -71,6 +79,82 @@ inline TimePoint now() {
       .count();
 }
 
+// Monotonic clock in nanoseconds, for measuring latencies below a millisecond
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Compile-time instrumentation, enabled with 'make instrument=yes'. A hook
+// INSTRUMENT(point) opens a scoped timer which adds the cycles spent until the
+// end of the enclosing block to the calling thread's counters. Without
+// USE_INSTRUMENT the hooks expand to nothing.
+enum InstrumentPoint {
+    INS_DO_MOVE,
+    INS_NEXT_MOVE,
+    INS_MOVE_SCORE,
+    INS_TRANSFORM,
+    INS_PROPAGATE,
+    INS_TT_PROBE,
+    INS_EXP_PROBE,
+    INS_TB_PROBE_WDL,
+    INS_POINT_NB
+};
+
+void instrument_clear();
+void instrument_print(uint64_t nodes = 0);
+
+#ifdef USE_INSTRUMENT
+
+// Time stamp counter on x86, nanoseconds elsewhere
+inline uint64_t instrument_cycles() {
+    #if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+    #else
+    return uint64_t(now_ns());
+    #endif
+}
+
+// Counters of one thread, only written by their owner so no atomics needed
+struct InstrumentCounters {
+    uint64_t calls[INS_POINT_NB];
+    uint64_t cycles[INS_POINT_NB];
+};
+
+InstrumentCounters* instrument_register();
+
+inline InstrumentCounters& instrument_counters() {
+    thread_local InstrumentCounters* counters = instrument_register();
+    return *counters;
+}
+
+class ScopedTimer {
+   public:
+    explicit ScopedTimer(InstrumentPoint p) :
+        point(p),
+        start(instrument_cycles()) {}
+    ~ScopedTimer() {
+        InstrumentCounters& c = instrument_counters();
+        c.calls[point] += 1;
+        c.cycles[point] += instrument_cycles() - start;
+    }
+
+   private:
+    InstrumentPoint point;
+    uint64_t        start;
+};
+
+    #define INSTRUMENT_NAME2(x, y) x##y
+    #define INSTRUMENT_NAME(x, y) INSTRUMENT_NAME2(x, y)
+    #define INSTRUMENT(point) ScopedTimer INSTRUMENT_NAME(scopedTimer, __LINE__)(point)
+
+#else
+
+    #define INSTRUMENT(point)
+
+#endif
+
 
 enum SyncCout {
     IO_LOCK,
@@ -388,6 +472,24 @@ class FileMapping {
         return (baseAddress != nullptr && dataSize != 0);
     }
 
+    // Asks the kernel to start reading the given range of the file (by default
+    // the whole file) into the page cache in the background, so that the
+    // following accesses do not wait for the disk one after the other.
+    void will_need(size_t offset = 0, size_t length = size_t(-1)) const {
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+        if (!has_data() || offset >= dataSize)
+            return;
+
+        constexpr size_t PageSize = 4096;
+        size_t           start    = offset & ~(PageSize - 1);
+        size_t           end      = length < dataSize - offset ? offset + length : dataSize;
+        madvise((char*) baseAddress + start, end - start, MADV_WILLNEED);
+#else
+        (void) offset;
+        (void) length;
+#endif
+    }
+
     const unsigned char* data() const {
         assert(mapping != 0 && baseAddress != nullptr && dataSize != 0);
         return (const unsigned char*) baseAddress;
@@ -20,6 +20,7 @@
 
 #include <cassert>
 #include <initializer_list>
+#include <type_traits>
 
 #include "bitboard.h"
 #include "position.h"
@@ -224,6 +225,147 @@ ExtMove* generate_all(const Position& pos, ExtMove* moveList) {
     return moveList;
 }
 
+
+// Generates the legal moves in one pass: the destinations of every piece are
+// restricted by the check mask, and by the pin line for the pinned ones, king
+// destinations are tested against the attacks of the opponent, and only en
+// passant and castling still need Position::legal(). With CountOnly the moves
+// are counted and not stored, which is all perft needs at the leaves.
+template<Color Us, bool CountOnly>
+size_t generate_legal(const Position& pos, [[maybe_unused]] ExtMove* moveList) {
+
+    constexpr Color     Them     = ~Us;
+    constexpr Bitboard  TRank7BB = (Us == WHITE ? Rank7BB : Rank2BB);
+    constexpr Bitboard  TRank3BB = (Us == WHITE ? Rank3BB : Rank6BB);
+    constexpr Direction Up       = pawn_push(Us);
+    constexpr Direction UpRight  = (Us == WHITE ? NORTH_EAST : SOUTH_WEST);
+    constexpr Direction UpLeft   = (Us == WHITE ? NORTH_WEST : SOUTH_EAST);
+
+    const Square   ksq      = pos.square<KING>(Us);
+    const Bitboard occupied = pos.pieces();
+    const Bitboard checkers = pos.checkers();
+    const Bitboard pinned   = pos.blockers_for_king(Us) & pos.pieces(Us);
+    const Bitboard enemies  = pos.pieces(Them);
+    size_t         count    = 0;
+
+    // Adds the moves from 'from' to every square of 'b'
+    auto add = [&](Square from, Bitboard b) {
+        if constexpr (CountOnly)
+            count += popcount(b);
+        else
+            while (b)
+                moveList[count++] = Move(from, pop_lsb(b));
+    };
+
+    // Adds the pawn moves 'D' to every square of 'b', with all the promotions
+    auto add_pawn = [&](Direction d, Bitboard b, bool promotion) {
+        if constexpr (CountOnly)
+            count += popcount(b) * (promotion ? 4 : 1);
+        else
+            while (b)
+            {
+                Square to = pop_lsb(b);
+                if (promotion)
+                    for (PieceType pt : {QUEEN, ROOK, BISHOP, KNIGHT})
+                        moveList[count++] = Move::make<PROMOTION>(to - d, to, pt);
+                else
+                    moveList[count++] = Move(to - d, to);
+            }
+    };
+
+    auto add_if_legal = [&](Move m) {
+        if (pos.legal(m))
+        {
+            if constexpr (!CountOnly)
+                moveList[count] = m;
+            ++count;
+        }
+    };
+
+    // In double check only the king can move
+    if (!more_than_one(checkers))
+    {
+        // Squares that resolve the check: the checker and the squares in between
+        const Bitboard target = checkers ? between_bb(ksq, lsb(checkers)) : ~Bitboard(0);
+
+        // Pawns, all the unpinned ones at once then each pinned one along its pin line
+        auto pawn_moves = [&](Bitboard pawns, Bitboard mask) {
+            const Bitboard emptyMask   = ~occupied & mask;
+            const Bitboard enemiesMask = enemies & mask;
+            Bitboard       pawnsOn7    = pawns & TRank7BB;
+            Bitboard       pawnsNotOn7 = pawns & ~TRank7BB;
+
+            Bitboard b1 = shift<Up>(pawnsNotOn7) & ~occupied;
+            Bitboard b2 = shift<Up>(b1 & TRank3BB) & emptyMask;
+
+            add_pawn(Up, b1 & mask, false);
+            add_pawn(Up + Up, b2, false);
+
+            if (pawnsOn7)
+            {
+                add_pawn(UpRight, shift<UpRight>(pawnsOn7) & enemiesMask, true);
+                add_pawn(UpLeft, shift<UpLeft>(pawnsOn7) & enemiesMask, true);
+                add_pawn(Up, shift<Up>(pawnsOn7) & emptyMask, true);
+            }
+
+            add_pawn(UpRight, shift<UpRight>(pawnsNotOn7) & enemiesMask, false);
+            add_pawn(UpLeft, shift<UpLeft>(pawnsNotOn7) & enemiesMask, false);
+        };
+
+        pawn_moves(pos.pieces(Us, PAWN) & ~pinned, target);
+
+        for (Bitboard b = pos.pieces(Us, PAWN) & pinned; b;)
+        {
+            Square from = pop_lsb(b);
+            pawn_moves(square_bb(from), target & line_bb(ksq, from));
+        }
+
+        // En passant may uncover a check along the rank, let legal() decide. A
+        // checking pawn can only be the one just pushed, it must be captured.
+        if (pos.ep_square() != SQ_NONE
+            && (!(checkers & pos.pieces(PAWN)) || (checkers & (pos.ep_square() - Up))))
+            for (Bitboard b = pos.pieces(Us, PAWN) & pawn_attacks_bb(Them, pos.ep_square()); b;)
+                add_if_legal(Move::make<EN_PASSANT>(pop_lsb(b), pos.ep_square()));
+
+        // Pinned knights can never move
+        for (Bitboard b = pos.pieces(Us, KNIGHT) & ~pinned; b;)
+        {
+            Square from = pop_lsb(b);
+            add(from, attacks_bb<KNIGHT>(from) & ~pos.pieces(Us) & target);
+        }
+
+        auto slider_moves = [&](auto pt) {
+            for (Bitboard b = pos.pieces(Us, decltype(pt)::value); b;)
+            {
+                Square   from = pop_lsb(b);
+                Bitboard to   = attacks_bb<decltype(pt)::value>(from, occupied) & ~pos.pieces(Us)
+                            & target;
+                add(from, pinned & from ? to & line_bb(ksq, from) : to);
+            }
+        };
+
+        slider_moves(std::integral_constant<PieceType, BISHOP>());
+        slider_moves(std::integral_constant<PieceType, ROOK>());
+        slider_moves(std::integral_constant<PieceType, QUEEN>());
+    }
+
+    // King moves, with the king removed from the board so that it cannot hide
+    // from a slider behind itself
+    for (Bitboard b = attacks_bb<KING>(ksq) & ~pos.pieces(Us); b;)
+    {
+        Square to = pop_lsb(b);
+        if (!(pos.attackers_to(to, occupied ^ ksq) & enemies))
+            add(ksq, square_bb(to));
+    }
+
+    if (!checkers && pos.can_castle(Us & ANY_CASTLING))
+        for (CastlingRights cr : {Us & KING_SIDE, Us & QUEEN_SIDE})
+            if (!pos.castling_impeded(cr) && pos.can_castle(cr))
+                add_if_legal(Move::make<CASTLING>(ksq, pos.castling_rook_square(cr)));
+
+    return count;
+}
+
 }  // namespace
 
 
@@ -260,21 +402,16 @@ template ExtMove* generate<NON_EVASIONS>(const Position&, ExtMove*);
 template<>
 ExtMove* generate<LEGAL>(const Position& pos, ExtMove* moveList) {
 
-    Color    us     = pos.side_to_move();
-    Bitboard pinned = pos.blockers_for_king(us) & pos.pieces(us);
-    Square   ksq    = pos.square<KING>(us);
-    ExtMove* cur    = moveList;
-
-    moveList =
-      pos.checkers() ? generate<EVASIONS>(pos, moveList) : generate<NON_EVASIONS>(pos, moveList);
-    while (cur != moveList)
-        if (((pinned & cur->from_sq()) || cur->from_sq() == ksq || cur->type_of() == EN_PASSANT)
-            && !pos.legal(*cur))
-            *cur = *(--moveList);
-        else
-            ++cur;
+    return moveList
+         + (pos.side_to_move() == WHITE ? generate_legal<WHITE, false>(pos, moveList)
+                                        : generate_legal<BLACK, false>(pos, moveList));
+}
 
-    return moveList;
+// Returns the number of legal moves in the given position, without storing them
+size_t legal_move_count(const Position& pos) {
+
+    return pos.side_to_move() == WHITE ? generate_legal<WHITE, true>(pos, nullptr)
+                                       : generate_legal<BLACK, true>(pos, nullptr);
 }
 
 }  // namespace Hypnos
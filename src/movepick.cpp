@@ -20,10 +20,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iterator>
 #include <utility>
 
+#if defined(USE_AVX2)
+    #include <immintrin.h>
+#endif
+
 #include "bitboard.h"
+#include "misc.h"
 #include "position.h"
 
 namespace Hypnos {
@@ -59,6 +65,8 @@ enum Stages {
     QCHECK
 };
 
+#if !defined(USE_AVX2)
+
 // Sort moves in descending order up to and including
 // a given limit. The order of moves smaller than the limit is left unspecified.
 void partial_insertion_sort(ExtMove* begin, ExtMove* end, int limit) {
@@ -74,6 +82,108 @@ void partial_insertion_sort(ExtMove* begin, ExtMove* end, int limit) {
         }
 }
 
+#endif
+
+// Vectorised scoring of captures and quiets. The history indices of the moves
+// are laid out in separate aligned arrays, the history values are gathered a
+// vector of moves at a time and the moves below the sort limit are found with
+// one compare per vector. Without AVX2 the ExtMove path below is used.
+//
+// The 16-bit entries are gathered as the 32-bit pair starting at the even index
+// below them, which the tables always hold since their rows have an even size,
+// so that no lane reads past the end of a table. The entry is then shifted down
+// for odd indices and sign extended.
+#if defined(USE_AVX512)
+
+using vec_t         = __m512i;
+constexpr int Lanes = 16;
+
+// The zero-masked forms of the shifts are used since the unmasked ones start from
+// an undefined vector, which GCC reports as used uninitialized.
+constexpr __mmask16 All = 0xFFFF;
+
+inline vec_t vec_load(const int* p) { return _mm512_load_si512(p); }
+inline void  vec_store(int* p, vec_t v) { _mm512_store_si512(p, v); }
+inline vec_t vec_add(vec_t a, vec_t b) { return _mm512_add_epi32(a, b); }
+
+// Sign extended 16-bit table entries at the given indices
+inline vec_t vec_gather16(const int16_t* table, vec_t idx) {
+    const vec_t one   = _mm512_set1_epi32(1);
+    const vec_t pair  = _mm512_maskz_andnot_epi32(All, one, idx);
+    const vec_t shift = _mm512_maskz_slli_epi32(All, _mm512_maskz_and_epi32(All, idx, one), 4);
+    const vec_t v = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), All, pair, table, 2);
+    return _mm512_maskz_srai_epi32(
+      All, _mm512_maskz_slli_epi32(All, _mm512_maskz_srlv_epi32(All, v, shift), 16), 16);
+}
+
+// Division by 2^Shift rounding towards zero, like the scalar code
+template<int Shift>
+inline vec_t vec_div(vec_t v) {
+    const vec_t sign = _mm512_maskz_srai_epi32(All, v, 31);
+    const vec_t bias = _mm512_maskz_srli_epi32(All, sign, 32 - Shift);
+    return _mm512_maskz_srai_epi32(All, _mm512_add_epi32(v, bias), Shift);
+}
+
+inline uint64_t vec_ge_mask(vec_t v, int limit) {
+    return _mm512_cmpge_epi32_mask(v, _mm512_set1_epi32(limit));
+}
+
+#elif defined(USE_AVX2)
+
+using vec_t         = __m256i;
+constexpr int Lanes = 8;
+
+inline vec_t vec_load(const int* p) { return _mm256_load_si256(reinterpret_cast<const vec_t*>(p)); }
+inline void  vec_store(int* p, vec_t v) { _mm256_store_si256(reinterpret_cast<vec_t*>(p), v); }
+inline vec_t vec_add(vec_t a, vec_t b) { return _mm256_add_epi32(a, b); }
+
+inline vec_t vec_gather16(const int16_t* table, vec_t idx) {
+    const vec_t pair  = _mm256_andnot_si256(_mm256_set1_epi32(1), idx);
+    const vec_t shift = _mm256_slli_epi32(_mm256_and_si256(idx, _mm256_set1_epi32(1)), 4);
+    const vec_t v =
+      _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(table),
+                                  pair, _mm256_set1_epi32(-1), 2);
+    return _mm256_srai_epi32(_mm256_slli_epi32(_mm256_srlv_epi32(v, shift), 16), 16);
+}
+
+template<int Shift>
+inline vec_t vec_div(vec_t v) {
+    const vec_t bias = _mm256_srli_epi32(_mm256_srai_epi32(v, 31), 32 - Shift);
+    return _mm256_srai_epi32(_mm256_add_epi32(v, bias), Shift);
+}
+
+inline uint64_t vec_ge_mask(vec_t v, int limit) {
+    const vec_t less = _mm256_cmpgt_epi32(_mm256_set1_epi32(limit), v);
+    return ~uint64_t(_mm256_movemask_ps(_mm256_castsi256_ps(less))) & 0xFF;
+}
+
+#endif
+
+#if defined(USE_AVX2)
+
+static_assert(MAX_MOVES % Lanes == 0, "Move buffers are padded to a multiple of Lanes");
+static_assert(SQUARE_NB % 2 == 0, "History rows have an even number of entries");
+
+// Same as partial_insertion_sort() when 'good' has the bits of the moves whose
+// value is at least the limit. Moves at a given index are only moved once the
+// loop has passed it, so the bits of the unsorted moves stay valid.
+void partial_insertion_sort(ExtMove* begin, const uint64_t* good, int n) {
+
+    ExtMove* sortedEnd = begin;
+
+    for (int w = 0; w * 64 < n; ++w)
+        for (Bitboard b = good[w] & (w ? ~0ULL : ~1ULL); b;)
+        {
+            ExtMove *p = begin + w * 64 + pop_lsb(b), tmp = *p, *q;
+            *p         = *++sortedEnd;
+            for (q = sortedEnd; q != begin && *(q - 1) < tmp; --q)
+                *q = *(q - 1);
+            *q = tmp;
+        }
+}
+
+#endif
+
 }  // namespace
 
 
@@ -219,6 +329,133 @@ void MovePicker::score() {
         }
 }
 
+// Scores the moves between cur and endMoves like score() and then sorts them in
+// descending order down to 'limit', like partial_insertion_sort().
+template<GenType Type>
+void MovePicker::score_and_sort(int limit) {
+
+    static_assert(Type == CAPTURES || Type == QUIETS, "Wrong type");
+
+    INSTRUMENT(INS_MOVE_SCORE);
+
+#if defined(USE_AVX2)
+
+    const int n      = int(endMoves - cur);
+    const int padded = (n + Lanes - 1) / Lanes * Lanes;
+
+    // Per move: the butterfly (or capture history) index, the [piece][to] index
+    // and the part of the score that does not come from the histories.
+    alignas(64) int fromTo[MAX_MOVES], pieceTo[MAX_MOVES], bonus[MAX_MOVES],
+      values[MAX_MOVES];
+
+    if constexpr (Type == CAPTURES)
+        for (int i = 0; i < n; ++i)
+        {
+            const Move   m        = cur[i];
+            const Square to       = m.to_sq();
+            const Piece  captured = pos.piece_on(to);
+
+            fromTo[i] = (int(pos.moved_piece(m)) * SQUARE_NB + to) * PIECE_TYPE_NB
+                      + type_of(captured);
+            bonus[i] = 7 * int(PieceValue[captured]);
+        }
+    else
+    {
+        Color us = pos.side_to_move();
+
+        Bitboard threatenedByPawn = pos.attacks_by<PAWN>(~us);
+        Bitboard threatenedByMinor =
+          pos.attacks_by<KNIGHT>(~us) | pos.attacks_by<BISHOP>(~us) | threatenedByPawn;
+        Bitboard threatenedByRook = pos.attacks_by<ROOK>(~us) | threatenedByMinor;
+
+        // Pieces threatened by pieces of lesser material value
+        Bitboard threatenedPieces = (pos.pieces(us, QUEEN) & threatenedByRook)
+                                  | (pos.pieces(us, ROOK) & threatenedByMinor)
+                                  | (pos.pieces(us, KNIGHT, BISHOP) & threatenedByPawn);
+
+        for (int i = 0; i < n; ++i)
+        {
+            const Move   m    = cur[i];
+            Piece        pc   = pos.moved_piece(m);
+            PieceType    pt   = type_of(pc);
+            const Square from = m.from_sq();
+            const Square to   = m.to_sq();
+
+            fromTo[i]  = m.from_to();
+            pieceTo[i] = pc * SQUARE_NB + to;
+
+            // bonus for checks
+            bonus[i] = bool(pos.check_squares(pt) & to) * 16384;
+
+            // bonus for escaping from capture
+            bonus[i] += threatenedPieces & from ? (pt == QUEEN && !(to & threatenedByRook)   ? 51000
+                                                   : pt == ROOK && !(to & threatenedByMinor) ? 24950
+                                                   : !(to & threatenedByPawn)                ? 14450
+                                                                                             : 0)
+                                                : 0;
+
+            // malus for putting piece en prise
+            bonus[i] -= !(threatenedPieces & from)
+                        ? (pt == QUEEN ? bool(to & threatenedByRook) * 48150
+                                           + bool(to & threatenedByMinor) * 10650
+                           : pt == ROOK ? bool(to & threatenedByMinor) * 24500
+                           : pt != PAWN ? bool(to & threatenedByPawn) * 14950
+                                        : 0)
+                        : 0;
+        }
+    }
+
+    // Padding lanes look up the first entry of each table and are never read back
+    for (int i = n; i < padded; ++i)
+        fromTo[i] = pieceTo[i] = bonus[i] = 0;
+
+    auto table = [](const auto& stats) { return reinterpret_cast<const int16_t*>(&stats); };
+
+    uint64_t good[MAX_MOVES / 64] = {};
+
+    for (int i = 0; i < padded; i += Lanes)
+    {
+        vec_t v;
+
+        if constexpr (Type == CAPTURES)
+            v = vec_div<4>(vec_add(vec_load(bonus + i),
+                                   vec_gather16(table(*captureHistory), vec_load(fromTo + i))));
+        else
+        {
+            const vec_t pt = vec_load(pieceTo + i);
+            const vec_t h  = vec_add(
+              vec_gather16(table((*mainHistory)[pos.side_to_move()]), vec_load(fromTo + i)),
+              vec_add(vec_gather16(table((*pawnHistory)[pawn_structure_index(pos)]), pt),
+                       vec_gather16(table(*continuationHistory[0]), pt)));
+
+            v = vec_add(h, h);
+            v = vec_add(v, vec_gather16(table(*continuationHistory[1]), pt));
+            v = vec_add(v, vec_div<2>(vec_gather16(table(*continuationHistory[2]), pt)));
+            v = vec_add(v, vec_gather16(table(*continuationHistory[3]), pt));
+            v = vec_add(v, vec_gather16(table(*continuationHistory[5]), pt));
+            v = vec_add(v, vec_load(bonus + i));
+        }
+
+        vec_store(values + i, v);
+        good[i / 64] |= vec_ge_mask(v, limit) << (i % 64);
+    }
+
+    if (n < MAX_MOVES)
+        good[n / 64] &= (1ULL << (n % 64)) - 1;  // Drop the padding lanes
+
+    for (int i = 0; i < n; ++i)
+        cur[i].value = values[i];
+
+    partial_insertion_sort(cur, good, n);
+
+#else
+
+    score<Type>();
+    partial_insertion_sort(cur, endMoves, limit);
+
+#endif
+}
+
 // Returns the next move satisfying a predicate function.
 // It never returns the TT move.
 template<MovePicker::PickType T, typename Pred>
@@ -242,6 +479,8 @@ Move MovePicker::select(Pred filter) {
 // moves left, picking the move with the highest score from a list of generated moves.
 Move MovePicker::next_move(bool skipQuiets) {
 
+    INSTRUMENT(INS_NEXT_MOVE);
+
     auto quiet_threshold = [](Depth d) { return -3330 * d; };
 
 top:    switch (stage)
@@ -260,8 +499,7 @@ top:    switch (stage)
         cur = endBadCaptures = moves;
         endMoves             = generate<CAPTURES>(pos, cur);
 
-        score<CAPTURES>();
-        partial_insertion_sort(cur, endMoves, std::numeric_limits<int>::min());
+        score_and_sort<CAPTURES>(std::numeric_limits<int>::min());
         ++stage;
         goto top;
 
@@ -298,8 +536,7 @@ top:    switch (stage)
             cur      = endBadCaptures;
             endMoves = beginBadQuiets = endBadQuiets = generate<QUIETS>(pos, cur);
 
-            score<QUIETS>();
-            partial_insertion_sort(cur, endMoves, quiet_threshold(depth));
+            score_and_sort<QUIETS>(quiet_threshold(depth));
         }
 
         ++stage;
@@ -181,6 +181,8 @@ class MovePicker {
     Move select(Pred);
     template<GenType>
     void     score();
+    template<GenType>
+    void     score_and_sort(int limit);
     ExtMove* begin() { return cur; }
     ExtMove* end() { return endMoves; }
 
@@ -177,18 +177,23 @@ static bool write_parameters(std::ostream& stream, NetSize netSize) {
     return bool(stream);
 }
 
-void hint_common_parent_position(const Position& pos) {
+void hint_common_parent_position(const Position& pos, AccumulatorUpdates& updates) {
 
     int simpleEvalAbs = std::abs(simple_eval(pos, pos.side_to_move()));
     if (simpleEvalAbs > Eval::SmallNetThreshold)
-        featureTransformerSmall->hint_common_access(pos, simpleEvalAbs > Eval::PsqtOnlyThreshold);
+        featureTransformerSmall->hint_common_access(pos, simpleEvalAbs > Eval::PsqtOnlyThreshold,
+                                                    updates);
     else
-        featureTransformerBig->hint_common_access(pos, false);
+        featureTransformerBig->hint_common_access(pos, false, updates);
 }
 
 // Evaluation function. Perform differential calculation.
 template<NetSize Net_Size>
-Value evaluate(const Position& pos, bool adjusted, int* complexity, bool psqtOnly) {
+Value evaluate(const Position&     pos,
+               bool                adjusted,
+               int*                complexity,
+               bool                psqtOnly,
+               AccumulatorUpdates* updates) {
 
     // We manually align the arrays on the stack because with gcc < 9.3
     // overaligning stack variables with alignas() doesn't work correctly.
@@ -213,10 +218,14 @@ Value evaluate(const Position& pos, bool adjusted, int* complexity, bool psqtOnl
 
     ASSERT_ALIGNED(transformedFeatures, alignment);
 
+    AccumulatorUpdates uncounted;
+
     const int bucket = (pos.count<ALL_PIECES>() - 1) / 4;
     const auto psqt = Net_Size == Small
-        ? featureTransformerSmall->transform(pos, transformedFeatures, bucket, psqtOnly)
-        : featureTransformerBig->transform(pos, transformedFeatures, bucket, psqtOnly);
+        ? featureTransformerSmall->transform(pos, transformedFeatures, bucket, psqtOnly,
+                                             updates ? *updates : uncounted)
+        : featureTransformerBig->transform(pos, transformedFeatures, bucket, psqtOnly,
+                                           updates ? *updates : uncounted);
 
     const auto positional = !psqtOnly
         ? (Net_Size == Small ? networkSmall[bucket]->propagate(transformedFeatures)
@@ -235,8 +244,16 @@ Value evaluate(const Position& pos, bool adjusted, int* complexity, bool psqtOnl
         return static_cast<Value>((psqt + positional) / OutputScale);
 }
 
-template Value evaluate<Big>(const Position& pos, bool adjusted, int* complexity, bool psqtOnly);
-template Value evaluate<Small>(const Position& pos, bool adjusted, int* complexity, bool psqtOnly);
+template Value evaluate<Big>(const Position&     pos,
+                             bool                adjusted,
+                             int*                complexity,
+                             bool                psqtOnly,
+                             AccumulatorUpdates* updates);
+template Value evaluate<Small>(const Position&     pos,
+                               bool                adjusted,
+                               int*                complexity,
+                               bool                psqtOnly,
+                               AccumulatorUpdates* updates);
 
 struct NnueEvalTrace {
     static_assert(LayerStacks == PSQTBuckets);
@@ -265,12 +282,13 @@ static NnueEvalTrace trace_evaluate(const Position& pos) {
 
     ASSERT_ALIGNED(transformedFeatures, alignment);
 
-    NnueEvalTrace t{};
+    NnueEvalTrace      t{};
+    AccumulatorUpdates updates;
     t.correctBucket = (pos.count<ALL_PIECES>() - 1) / 4;
     for (IndexType bucket = 0; bucket < LayerStacks; ++bucket)
     {
         const auto materialist =
-          featureTransformerBig->transform(pos, transformedFeatures, bucket, false);
+          featureTransformerBig->transform(pos, transformedFeatures, bucket, false, updates);
         const auto positional = networkBig[bucket]->propagate(transformedFeatures);
 
         t.psqt[bucket]       = static_cast<Value>(materialist / OutputScale);
@@ -72,13 +72,14 @@ Value evaluate(const Value psqt, const Value positional, const int delta, const
 
 // Template specialization declarations
 template<NetSize Net_Size>
-Value evaluate(const Position& pos,
-               bool            adjusted   = false,
-               int*            complexity = nullptr,
-               bool            psqtOnly   = false);
+Value evaluate(const Position&     pos,
+               bool                adjusted   = false,
+               int*                complexity = nullptr,
+               bool                psqtOnly   = false,
+               AccumulatorUpdates* updates    = nullptr);
 
 std::string trace(Position& pos);
-void  hint_common_parent_position(const Position& pos);
+void  hint_common_parent_position(const Position& pos, AccumulatorUpdates& updates);
 bool load_eval(const std::string name, std::istream& stream, NetSize netSize);
 bool save_eval(std::ostream& stream, NetSize netSize);
 bool save_eval(const std::optional<std::string>& filename, NetSize netSize);
@@ -37,6 +37,13 @@ struct alignas(CacheLineSize) Accumulator {
 	bool         computedPSQT[2];
 };
 
+// Number of accumulators brought up to date by the feature transformer, either
+// incrementally from an earlier position or by a full refresh
+struct AccumulatorUpdates {
+    int incremental = 0;
+    int refreshes   = 0;
+};
+
 }  // namespace Hypnos::Eval::NNUE
 
 #endif  // NNUE_ACCUMULATOR_H_INCLUDED
@@ -97,6 +97,8 @@ struct Network {
     }
 
     std::int32_t propagate(const TransformedFeatureType* transformedFeatures) {
+        INSTRUMENT(INS_PROPAGATE);
+
         struct alignas(CacheLineSize) Buffer {
             alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
             alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
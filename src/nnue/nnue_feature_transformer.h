@@ -250,10 +250,15 @@ class FeatureTransformer {
     }
 
     // Convert input features
-    std::int32_t
-    transform(const Position& pos, OutputType* output, int bucket, bool psqtOnly) const {
-        update_accumulator<WHITE>(pos, psqtOnly);
-        update_accumulator<BLACK>(pos, psqtOnly);
+    std::int32_t transform(const Position&     pos,
+                           OutputType*         output,
+                           int                 bucket,
+                           bool                psqtOnly,
+                           AccumulatorUpdates& updates) const {
+        INSTRUMENT(INS_TRANSFORM);
+
+        update_accumulator<WHITE>(pos, psqtOnly, updates);
+        update_accumulator<BLACK>(pos, psqtOnly, updates);
 
         const Color perspectives[2]  = {pos.side_to_move(), ~pos.side_to_move()};
         const auto& psqtAccumulation = (pos.state()->*accPtr).psqtAccumulation;
@@ -315,9 +320,10 @@ class FeatureTransformer {
         return psqt;
     }  // end of function transform()
 
-    void hint_common_access(const Position& pos, bool psqtOnly) const {
-        hint_common_access_for_perspective<WHITE>(pos, psqtOnly);
-        hint_common_access_for_perspective<BLACK>(pos, psqtOnly);
+    void
+    hint_common_access(const Position& pos, bool psqtOnly, AccumulatorUpdates& updates) const {
+        hint_common_access_for_perspective<WHITE>(pos, psqtOnly, updates);
+        hint_common_access_for_perspective<BLACK>(pos, psqtOnly, updates);
     }
 
    private:
@@ -708,7 +714,9 @@ class FeatureTransformer {
     }
 
     template<Color Perspective>
-    void hint_common_access_for_perspective(const Position& pos, bool psqtOnly) const {
+    void hint_common_access_for_perspective(const Position&     pos,
+                                            bool                psqtOnly,
+                                            AccumulatorUpdates& updates) const {
 
         // Works like update_accumulator, but performs less work.
         // Updates ONLY the accumulator for pos.
@@ -729,13 +737,18 @@ class FeatureTransformer {
             StateInfo* states_to_update[2] = {pos.state(), nullptr};
             update_accumulator_incremental<Perspective, 2>(pos, oldest_st, states_to_update,
                                                            psqtOnly);
+            ++updates.incremental;
         }
         else
+        {
             update_accumulator_refresh<Perspective>(pos, psqtOnly);
+            ++updates.refreshes;
+        }
     }
 
     template<Color Perspective>
-    void update_accumulator(const Position& pos, bool psqtOnly) const {
+    void
+    update_accumulator(const Position& pos, bool psqtOnly, AccumulatorUpdates& updates) const {
 
         auto [oldest_st, next] = try_find_computed_accumulator<Perspective>(pos, psqtOnly);
 
@@ -755,9 +768,13 @@ class FeatureTransformer {
 
             update_accumulator_incremental<Perspective, 3>(pos, oldest_st, states_to_update,
                                                            psqtOnly);
+            ++updates.incremental;
         }
         else
+        {
             update_accumulator_refresh<Perspective>(pos, psqtOnly);
+            ++updates.refreshes;
+        }
     }
 
     alignas(CacheLineSize) BiasType biases[HalfDimensions];
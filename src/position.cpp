@@ -32,6 +32,7 @@
 #include <utility>
 
 #include "bitboard.h"
+#include "book/polyglot/polyglot.h"
 #include "misc.h"
 #include "movegen.h"
 #include "nnue/nnue_common.h"
@@ -56,6 +57,9 @@ namespace {
 
 constexpr std::string_view PieceToChar(" PNBRQK  pnbrqk");
 
+// Whether do_move() maintains StateInfo::polyglotKey: the number of open BIN books
+std::atomic<int> TrackPolyglotKey = 0;
+
 constexpr Piece Pieces[] = {W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
                             B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING};
 }  // namespace
@@ -1148,6 +1152,103 @@ void Position::set_state() const {
     for (Piece pc : Pieces)
         for (int cnt = 0; cnt < pieceCount[pc]; ++cnt)
             st->materialKey ^= Zobrist::psq[pc][cnt];
+
+    st->polyglotKey = compute_polyglot_key();
+}
+
+
+// Enables or disables the incremental update of the Polyglot key in do_move().
+// Calls are counted, so the key is maintained as long as one BIN book is open.
+void Position::track_polyglot_key(bool on) { TrackPolyglotKey += on ? 1 : -1; }
+
+
+// Computes the Polyglot book key of the position from scratch
+Key Position::compute_polyglot_key() const {
+
+    const auto& z = Book::Polyglot::Zobrist;
+    Key         k = z.castling[st->castlingRights];
+
+    for (Bitboard b = pieces(); b;)
+    {
+        Square s = pop_lsb(b);
+        k ^= z.psq[piece_on(s)][s];
+    }
+
+    if (st->epSquare != SQ_NONE)
+        k ^= z.enpassant[file_of(st->epSquare)];
+
+    if (sideToMove == WHITE)
+        k ^= z.side;
+
+    return k;
+}
+
+
+// Returns the change of the Polyglot key caused by move m. Called by do_move()
+// once the board and the new state are updated, before switching the side to move.
+Key Position::polyglot_key_delta(Move m, Piece pc, Piece captured) const {
+
+    const auto&      z    = Book::Polyglot::Zobrist;
+    const StateInfo* prev = st->previous;
+    Color            us   = sideToMove;
+    Square           from = m.from_sq();
+    Square           to   = m.to_sq();
+    Key k = z.side ^ z.castling[prev->castlingRights] ^ z.castling[st->castlingRights];
+
+    if (m.type_of() == CASTLING)
+    {
+        // Move is encoded as 'king captures rook'
+        bool  kingSide = to > from;
+        Piece rook     = make_piece(us, ROOK);
+        k ^= z.psq[pc][from] ^ z.psq[pc][relative_square(us, kingSide ? SQ_G1 : SQ_C1)];
+        k ^= z.psq[rook][to] ^ z.psq[rook][relative_square(us, kingSide ? SQ_F1 : SQ_D1)];
+    }
+    else
+    {
+        k ^= z.psq[pc][from] ^ z.psq[piece_on(to)][to];  // Promotions included
+
+        if (captured)
+            k ^= z.psq[captured][m.type_of() == EN_PASSANT ? to - pawn_push(us) : to];
+    }
+
+    if (prev->epSquare != SQ_NONE)
+        k ^= z.enpassant[file_of(prev->epSquare)];
+
+    if (st->epSquare != SQ_NONE)
+        k ^= z.enpassant[file_of(st->epSquare)];
+
+    return k;
+}
+
+
+// Overload to initialize the position object as a copy of another one, without
+// a round-trip through FEN. The current state, including the NNUE accumulators,
+// is copied into 'si' but the history is not, exactly like after set() from the
+// FEN of 'pos'.
+Position& Position::set(const Position& pos, StateInfo* si, Thread* th) {
+
+    std::memcpy(board, pos.board, sizeof(board));
+    std::memcpy(byTypeBB, pos.byTypeBB, sizeof(byTypeBB));
+    std::memcpy(byColorBB, pos.byColorBB, sizeof(byColorBB));
+    std::memcpy(pieceCount, pos.pieceCount, sizeof(pieceCount));
+    std::memcpy(castlingRightsMask, pos.castlingRightsMask, sizeof(castlingRightsMask));
+    std::memcpy(castlingRookSquare, pos.castlingRookSquare, sizeof(castlingRookSquare));
+    std::memcpy(castlingPath, pos.castlingPath, sizeof(castlingPath));
+
+    gamePly    = pos.gamePly;
+    sideToMove = pos.sideToMove;
+    chess960   = pos.chess960;
+    thisThread = th;
+
+    *si               = *pos.st;
+    si->previous      = nullptr;
+    si->pliesFromNull = 0;
+    si->repetition    = 0;
+    st                = si;
+
+    assert(pos_is_ok());
+
+    return *this;
 }
 
 
@@ -1444,6 +1545,8 @@ bool Position::gives_check(Move m) const {
 // moves should be filtered out before this function is called.
 void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
+    INSTRUMENT(INS_DO_MOVE);
+
     assert(m.is_ok());
     assert(&newSt != st);
 
@@ -1615,6 +1718,11 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
     // Update the key with the final value
     st->key = k;
 
+    // The Polyglot key is only maintained while a BIN book is loaded
+    st->polyglotKey = TrackPolyglotKey.load(std::memory_order_relaxed) && st->previous->polyglotKey
+                      ? st->previous->polyglotKey ^ polyglot_key_delta(m, pc, captured)
+                      : 0;
+
     // Calculate checkers bitboard (if move gives check)
     st->checkersBB = givesCheck ? attackers_to(square<KING>(them)) & pieces(us) : 0;
 
@@ -1761,6 +1869,13 @@ void Position::do_null_move(StateInfo& newSt) {
           st->accumulatorSmall.computedPSQT[WHITE] = st->accumulatorSmall.computedPSQT[BLACK] =
             false;
 
+    if (st->polyglotKey)
+    {
+        st->polyglotKey ^= Book::Polyglot::Zobrist.side;
+        if (st->epSquare != SQ_NONE)
+            st->polyglotKey ^= Book::Polyglot::Zobrist.enpassant[file_of(st->epSquare)];
+    }
+
     if (st->epSquare != SQ_NONE)
     {
         st->key ^= Zobrist::enpassant[file_of(st->epSquare)];
@@ -2081,6 +2196,9 @@ bool Position::pos_is_ok() const {
                 assert(0 && "pos_is_ok: Castling");
         }
 
+    if (st->polyglotKey && st->polyglotKey != compute_polyglot_key())
+        assert(0 && "pos_is_ok: Polyglot key");
+
     return true;
 }
 
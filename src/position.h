@@ -49,6 +49,7 @@ struct StateInfo {
 
     // Not copied when making a move (will be recomputed anyhow)
     Key        key;
+    Key        polyglotKey;  // Zero when not maintained, see Position::polyglot_key()
     Bitboard   checkersBB;
     StateInfo* previous;
     Bitboard   blockersForKing[COLOR_NB];
@@ -80,6 +81,7 @@ class Thread;
 class Position {
    public:
     static void init();
+    static void track_polyglot_key(bool on);
 
     Position()                           = default;
     Position(const Position&)            = delete;
@@ -88,6 +90,7 @@ class Position {
     // FEN string input/output
     Position&   set(const std::string& fenStr, bool isChess960, StateInfo* si, Thread* th);
     Position&   set(const std::string& code, Color c, StateInfo* si);
+    Position&   set(const Position& pos, StateInfo* si, Thread* th);
     std::string fen() const;
 
     // Position representation
@@ -150,6 +153,7 @@ class Position {
     Key key_after(Move m) const;
     Key material_key() const;
     Key pawn_key() const;
+    Key polyglot_key() const;
 
     // Other properties of the position
     Color   side_to_move() const;
@@ -185,6 +189,8 @@ class Position {
     void do_castling(Color us, Square from, Square& to, Square& rfrom, Square& rto);
     template<bool AfterMove>
     Key adjust_key50(Key k) const;
+    Key compute_polyglot_key() const;
+    Key polyglot_key_delta(Move m, Piece pc, Piece captured) const;
 
     // Data members
     Piece      board[SQUARE_NB];
@@ -301,6 +307,13 @@ inline Key Position::pawn_key() const { return st->pawnKey; }
 
 inline Key Position::material_key() const { return st->materialKey; }
 
+// Returns the key used by Polyglot opening books. It is updated incrementally
+// by do_move() only while a BIN book is loaded, and computed from scratch
+// otherwise.
+inline Key Position::polyglot_key() const {
+    return st->polyglotKey ? st->polyglotKey : compute_polyglot_key();
+}
+
 inline Value Position::non_pawn_material(Color c) const { return st->nonPawnMaterial[c]; }
 
 inline Value Position::non_pawn_material() const {
@@ -25,11 +25,14 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "bitboard.h"
 #include "evaluate.h"
@@ -52,6 +55,7 @@ namespace Hypnos {
 namespace Search {
 
 LimitsType Limits;
+ClearTimes LastClear;
 }
 
 namespace Tablebases {
@@ -142,7 +146,8 @@ struct Skill {
     Move   best = Move::none();
 };
 
-int variety;
+int  variety, varietyMaxScore, varietyMaxMoves;
+bool expProbe;  // Probe the experience data at every node, see seed_tt_from_experience()
 
 template<NodeType nodeType>
 Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cutNode);
@@ -153,6 +158,7 @@ Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth = 0
 Value value_to_tt(Value v, int ply);
 Value value_from_tt(Value v, int ply, int r50c);
 void  update_pv(Move* pv, Move move, const Move* childPv);
+void  hint_common_parent_position(const Position& pos, Thread* thisThread);
 void  update_continuation_histories(Stack* ss, Piece pc, Square to, int bonus);
 void  update_quiet_stats(const Position& pos, Stack* ss, Move move, int bonus);
 void  update_all_stats(const Position& pos,
@@ -167,32 +173,279 @@ void  update_all_stats(const Position& pos,
                        int             captureCount,
                        Depth           depth);
 
-// Utility to verify move generation. All the leaf nodes up
-// to the given depth are generated and counted, and the sum is returned.
-template<bool Root>
+// Lockless hash table of perft subtree counts keyed by position key and depth,
+// shared by all threads. An entry stores the count and the count xor-ed with the
+// key, so a torn entry written by two threads at once never verifies. It has a
+// fixed size of 64 MB, independent of the Hash option, and only exists during a
+// perft run.
+class PerftHash {
+
+    static constexpr size_t MbSize = 64;
+
+    struct Entry {
+        std::atomic<uint64_t> keyXorCount;
+        std::atomic<uint64_t> count;
+    };
+
+    std::unique_ptr<Entry[]> table;
+    size_t                   entryCount = 0;
+
+    static Key entry_key(Key key, Depth depth) {
+        return key ^ (uint64_t(depth) * 0x9E3779B97F4A7C15ULL);
+    }
+
+   public:
+    // Allocates the table and zeroes it, each thread of the pool clearing its
+    // share. Called by the main thread while the other threads are idle.
+    void allocate() {
+        entryCount = MbSize * 1024 * 1024 / sizeof(Entry);
+        table.reset(new Entry[entryCount]);
+
+        const size_t threadCount = Threads.size();
+
+        auto clear = [this, threadCount](size_t idx) {
+            const size_t stride = entryCount / threadCount, start = stride * idx,
+                         len = idx != threadCount - 1 ? stride : entryCount - start;
+
+            std::memset(static_cast<void*>(&table[start]), 0, len * sizeof(Entry));
+        };
+
+        for (auto it = Threads.begin() + 1; it < Threads.end(); ++it)
+            (*it)->run_custom_job([clear, idx = size_t(it - Threads.begin())]() { clear(idx); });
+
+        clear(0);
+
+        for (auto it = Threads.begin() + 1; it < Threads.end(); ++it)
+            (*it)->wait_for_search_finished();
+    }
+
+    void free() {
+        table.reset();
+        entryCount = 0;
+    }
+
+    bool probe(Key key, Depth depth, uint64_t& count) const {
+        if (!entryCount)
+            return false;
+
+        Key    k = entry_key(key, depth);
+        Entry& e = table[mul_hi64(k, entryCount)];
+
+        count = e.count.load(std::memory_order_relaxed);
+        return (e.keyXorCount.load(std::memory_order_relaxed) ^ count) == k;
+    }
+
+    void store(Key key, Depth depth, uint64_t count) {
+        if (!entryCount)
+            return;
+
+        Key    k = entry_key(key, depth);
+        Entry& e = table[mul_hi64(k, entryCount)];
+
+        e.keyXorCount.store(k ^ count, std::memory_order_relaxed);
+        e.count.store(count, std::memory_order_relaxed);
+    }
+};
+
+// Shared state of a perft run: the root moves are handed out to the threads
+// one at a time, and each thread records its node count and its time.
+struct PerftRun {
+    Depth                 depth;
+    std::vector<Move>     moves;
+    std::vector<uint64_t> counts;
+    std::vector<int64_t>  threadTime;
+    std::atomic<size_t>   nextMove;
+    PerftHash             hash;
+};
+
+PerftRun Perft;
+
+// Utility to verify move generation. All the leaf nodes up to the given depth
+// are generated and counted, and the sum is returned. The leaves are counted in
+// bulk from the size of the move list one ply above them, and the counts of the
+// subtrees are cached in the perft hash table.
 uint64_t perft(Position& pos, Depth depth) {
 
+    if (depth <= 1)
+        return legal_move_count(pos);
+
+    uint64_t nodes;
+    Key      key = pos.state()->key;  // Counts do not depend on the 50-move counter
+
+    if (Perft.hash.probe(key, depth, nodes))
+        return nodes;
+
     StateInfo st{};
     ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
 
-    uint64_t   cnt, nodes = 0;
-    const bool leaf = (depth == 2);
-
+    nodes = 0;
     for (const auto& m : MoveList<LEGAL>(pos))
     {
-        if (Root && depth <= 1)
-            cnt = 1, nodes++;
-        else
+        pos.do_move(m, st);
+        nodes += perft(pos, depth - 1);
+        pos.undo_move(m);
+    }
+
+    Perft.hash.store(key, depth, nodes);
+    return nodes;
+}
+
+// Perft of the root moves handed out to the given thread
+void perft_worker(Thread* th) {
+
+    int64_t   start = now_ns();
+    uint64_t  nodes = 0;
+    StateInfo st{};
+    ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
+
+    for (size_t i; (i = Perft.nextMove.fetch_add(1)) < Perft.moves.size();)
+    {
+        uint64_t cnt = 1;
+
+        if (Perft.depth > 1)
         {
-            pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - 1);
-            nodes += cnt;
-            pos.undo_move(m);
+            th->rootPos.do_move(Perft.moves[i], st);
+            cnt = perft(th->rootPos, Perft.depth - 1);
+            th->rootPos.undo_move(Perft.moves[i]);
         }
-        if (Root)
-            sync_cout << UCI::move(m, pos.is_chess960()) << ": " << cnt << sync_endl;
+
+        Perft.counts[i] = cnt;
+        nodes += cnt;
     }
-    return nodes;
+
+    th->nodes                  = nodes;
+    Perft.threadTime[th->id()] = now_ns() - start;
+}
+
+// Experience pre-seeding walks the experience graph from the root: the best
+// experience entry of every position is stored in the TT, and the walk goes on
+// into the positions reached by all the experience moves. The walk is stopped
+// after maxTime (0 for no limit), checked every TimeCheckNodes positions.
+struct ExperienceSeed {
+    static constexpr int    SplitPly       = 2;
+    static constexpr size_t TimeCheckNodes = 1024;
+
+    int                            maxPly;
+    size_t                         maxNodes;
+    TimePoint                      maxTime;
+    std::atomic<size_t>            nodes;
+    std::atomic<bool>              timeout;
+    std::vector<std::vector<Move>> tasks;
+    std::atomic<size_t>            nextTask;
+};
+
+ExperienceSeed Seed;
+
+// Seeds the TT from 'pos' and its experience successors. When 'split' is set,
+// the positions at SplitPly are not walked but queued as tasks for the threads.
+void seed_walk(Position& pos, int ply, std::vector<Move>& path, bool split) {
+
+    if (split && ply == ExperienceSeed::SplitPly)
+    {
+        Seed.tasks.push_back(path);
+        return;
+    }
+
+    const size_t n = Seed.nodes.fetch_add(1, std::memory_order_relaxed);
+
+    if (n >= Seed.maxNodes || Seed.timeout.load(std::memory_order_relaxed))
+        return;
+
+    if (Seed.maxTime && n % ExperienceSeed::TimeCheckNodes == 0 && Time.elapsed() >= Seed.maxTime)
+    {
+        Seed.timeout.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    const Experience::ExpEntryEx* exp = Experience::probe(pos.key());
+    if (!exp)
+        return;
+
+    const Experience::ExpEntryEx* best = exp;
+    for (const auto* e = exp->next(); e; e = e->next())
+        if (e->compare(best) > 0)
+            best = e;
+
+    bool     ttHit;
+    TTEntry* tte = TT.probe(pos.key(), ttHit);
+
+    if (!ttHit || best->depth > tte->depth())
+        tte->save(pos.key(), best->value, true, BOUND_EXACT, best->depth, best->move, VALUE_NONE);
+
+    if (ply >= Seed.maxPly)
+        return;
+
+    StateInfo st;
+    ASSERT_ALIGNED(&st, Eval::NNUE::CacheLineSize);
+
+    for (const auto* e = exp; e; e = e->next())
+        if (pos.pseudo_legal(e->move) && pos.legal(e->move))
+        {
+            path.push_back(e->move);
+            pos.do_move(e->move, st);
+            seed_walk(pos, ply + 1, path, split);
+            pos.undo_move(e->move);
+            path.pop_back();
+        }
+}
+
+// Walks the queued positions at SplitPly on thread 'th'
+void seed_worker(const Position& root, Thread* th) {
+
+    for (size_t i; (i = Seed.nextTask.fetch_add(1)) < Seed.tasks.size();)
+    {
+        std::deque<StateInfo> states(1);
+        Position              pos;
+        pos.set(root, &states.back(), th);
+
+        for (Move m : Seed.tasks[i])
+            pos.do_move(m, states.emplace_back());
+
+        std::vector<Move> path;
+        seed_walk(pos, ExperienceSeed::SplitPly, path, false);
+    }
+}
+
+// Stores the experience of the positions up to 'maxPly' plies from the root in
+// the TT, visiting at most 'maxNodes' positions. This is done once per search,
+// before the helper threads start, so that the search can skip the experience
+// probe at every node and read the experience moves and values from the TT.
+// The first plies are walked serially and the subtrees below them in parallel
+// on the idle helper threads, whose stacks are large enough for the recursion.
+// With a clock, seeding may only use a small part of the time for the move.
+void seed_tt_from_experience(const Position& root, int maxPly, size_t maxNodes) {
+
+    Seed.maxPly   = maxPly;
+    Seed.maxNodes = maxNodes;
+    Seed.maxTime  = Limits.use_time_management() ? Time.optimum() / 32
+                  : Limits.movetime              ? Limits.movetime / 32
+                                                 : 0;
+    Seed.nodes    = 0;
+    Seed.timeout  = false;
+    Seed.nextTask = 0;
+    Seed.tasks.clear();
+
+    std::deque<StateInfo> states(1);
+    Position              pos;
+    std::vector<Move>     path;
+    pos.set(root, &states.back(), root.this_thread());
+
+    const bool split = maxPly > ExperienceSeed::SplitPly && Threads.size() > 1;
+    seed_walk(pos, 0, path, split);
+
+    const auto workers = Threads.begin() + std::min(Threads.size(), Seed.tasks.size());
+
+    for (auto it = Threads.begin() + 1; it < workers; ++it)
+        (*it)->run_custom_job([&root, th = *it]() { seed_worker(root, th); });
+
+    seed_worker(root, root.this_thread());
+
+    for (auto it = Threads.begin() + 1; it < workers; ++it)
+        (*it)->wait_for_search_finished();
+
+    // The moves made while seeding are not part of the search
+    for (Thread* th : Threads)
+        th->nodes = 0;
 }
 
 }  // namespace
@@ -211,13 +464,23 @@ void Search::clear() {
 
     Threads.main()->wait_for_search_finished();
 
+    int64_t t0 = now_ns(), t1;
+
     Time.availableNodes = 0;
     TT.clear();
+    LastClear.tt = (t1 = now_ns()) - t0;
+
     Threads.clear();
-    Tablebases::init(Options["SyzygyPath"]);  // Free mapped files
+    LastClear.histories = (t0 = now_ns()) - t1;
+
+    // Keep the mapped files unless the path has changed
+    Tablebases::clear(Options["SyzygyPath"]);
+    LastClear.tablebases = (t1 = now_ns()) - t0;
 
     Experience::save();
+    Experience::refresh();
     Experience::resume_learning();
+    LastClear.experience = now_ns() - t1;
 }
 
 
@@ -225,10 +488,48 @@ void Search::clear() {
 // command. It searches from the root position and outputs the "bestmove".
 void MainThread::search() {
 
+    wakeTime = now_ns();
+
     if (Limits.perft)
     {
-        nodes = perft<true>(rootPos, Limits.perft);
-        sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
+        // The root moves are split across the threads, which share the perft hash
+        Perft.depth = Limits.perft;
+        Perft.moves.clear();
+        for (const auto& m : MoveList<LEGAL>(rootPos))
+            Perft.moves.push_back(m);
+
+        Perft.counts.assign(Perft.moves.size(), 0);
+        Perft.threadTime.assign(Threads.size(), 0);
+        Perft.nextMove = 0;
+        Perft.hash.allocate();
+
+        Threads.start_searching();  // start non-main threads
+        perft_worker(this);
+        Threads.wait_for_search_finished();
+
+        Perft.hash.free();
+
+        for (size_t i = 0; i < Perft.moves.size(); ++i)
+            sync_cout << UCI::move(Perft.moves[i], rootPos.is_chess960()) << ": "
+                      << Perft.counts[i] << sync_endl;
+
+        uint64_t total   = Threads.nodes_searched();
+        int64_t  elapsed = std::max<int64_t>(now_ns() - Threads.goTime, 1);
+
+        sync_cout << "\nNodes searched: " << total << "\n" << sync_endl;
+
+        for (Thread* th : Threads)
+        {
+            std::string name = "Thread " + std::to_string(th->id());
+            int64_t     time = std::max<int64_t>(Perft.threadTime[th->id()], 1);
+
+            sync_cout << name << std::string(16 - std::min<size_t>(name.size(), 16), ' ') << ": "
+                      << th->nodes << " nodes, " << uint64_t(th->nodes * 1e9 / time)
+                      << " nodes/second" << sync_endl;
+        }
+
+        sync_cout << "Total time (ms) : " << elapsed / 1000000 << "\nNodes/second    : "
+                  << uint64_t(total * 1e9 / elapsed) << sync_endl;
         return;
     }
 
@@ -238,7 +539,11 @@ void MainThread::search() {
     const Color us = rootPos.side_to_move();
     Time.init(Limits, us, rootPos.game_ply());
     TT.new_search();
-    variety = Options["Variety"];
+    const auto opts = UCI::snapshot();
+    variety         = opts->variety;
+    varietyMaxScore = opts->varietyMaxScore;
+    varietyMaxMoves = opts->varietyMaxMoves;
+    expProbe        = Experience::enabled() && !opts->expPrefillPlies;
     Eval::NNUE::verify();
     Move bookMove = Move::none();
 
@@ -259,17 +564,16 @@ void MainThread::search() {
             bookMove = Book::probe(rootPos);
 
             // Check experience book
-            if (bookMove == Move::none() && (bool) Options["Experience Book"]
-                && rootPos.game_ply() / 2 < (int) Options["Experience Book Max Moves"]
-                && Experience::enabled())
+            if (bookMove == Move::none() && opts->expBook
+                && rootPos.game_ply() / 2 < opts->expBookMaxMoves && Experience::enabled())
             {
-                const auto  expBookMinDepth = Depth(Options["Experience Book Min Depth"]);
-                const auto  expBookWidth    = uint32_t(Options["Experience Book Width"]);
+                const auto  expBookMinDepth = Depth(opts->expBookMinDepth);
+                const auto  expBookWidth    = uint32_t(opts->expBookWidth);
                 const auto* exp             = Experience::probe(rootPos.key());
 
                 if (exp)
                 {
-                    const auto  evalImportance = int(Options["Experience Book Eval Importance"]);
+                    const auto  evalImportance = opts->expBookEvalImportance;
                     const auto* temp           = exp;
 
                     std::vector<std::pair<const Experience::ExpEntryEx*, int>> quality;
@@ -284,7 +588,7 @@ void MainThread::search() {
                                 quality.emplace_back(temp, q);
                         }
 
-                        temp = temp->next;
+                        temp = temp->next();
                     }
 
                     if (!quality.empty())
@@ -344,6 +648,14 @@ void MainThread::search() {
         }
         if (think)
         {
+            // Every probe of the experience server would be a round trip
+            if (!expProbe && Experience::enabled() && !Experience::is_remote())
+                seed_tt_from_experience(rootPos, opts->expPrefillPlies,
+                                        size_t(opts->expPrefillNodes));
+
+            // The experience server is not queried by the search threads
+            Experience::pause_lookups();
+
             Threads.start_searching();  // start non-main threads
             Thread::search();           // main thread start searching
         }
@@ -352,11 +664,14 @@ void MainThread::search() {
     // When we reach the maximum depth, we can arrive here without a raise of
     // Threads.stop. However, if we are pondering or in an infinite search,
     // the UCI protocol states that we shouldn't print the best move before the
-    // GUI sends a "stop" or "ponderhit" command. We therefore simply wait here
+    // GUI sends a "stop" or "ponderhit" command. We therefore block here
     // until the GUI sends one of those commands.
+    // In MultiPV split mode the other thread groups also have to complete
+    // the requested depth before their lines can be reported.
+    if (Threads.rootGroups > 1 && Limits.depth)
+        Threads.wait_for_search_finished();
 
-    while (!Threads.stop && (ponder || Limits.infinite))
-    {}  // Busy wait for a stop or a ponder reset
+    wait_for_stop_or_ponderhit();
 
     // Stop the threads if not already stopped (also raise the stop if
     // "ponderhit" just reset Threads.ponder).
@@ -364,24 +679,39 @@ void MainThread::search() {
 
     // Wait until all threads have finished
     Threads.wait_for_search_finished();
+    Experience::resume_lookups();
 
     // When playing in 'nodes as time' mode, subtract the searched nodes from
     // the available ones before exiting.
     if (Limits.npmsec)
         Time.availableNodes += Limits.inc[us] - Threads.nodes_searched();
 
+    // In MultiPV split mode our own root moves are only a subset, so replace
+    // them with the lines merged from all the thread groups.
+    if (Threads.rootGroups > 1)
+    {
+        RootMoves          merged;
+        std::vector<Depth> depths;
+        Threads.merge_root_moves(merged, depths);
+
+        if (!merged.empty())
+        {
+            rootMoves      = std::move(merged);
+            completedDepth = *std::max_element(depths.begin(), depths.end());
+        }
+    }
+
     Thread* bestThread = this;
-    Skill   skill =
-      Skill(Options["Skill Level"], Options["UCI_LimitStrength"] ? int(Options["UCI_Elo"]) : 0);
+    Skill   skill(opts->skillLevel, opts->limitStrength ? opts->elo : 0);
 
-    if (int(Options["MultiPV"]) == 1 && !Limits.depth && !skill.enabled()
+    if (opts->multiPV == 1 && !Limits.depth && !skill.enabled()
         && rootMoves[0].pv[0] != Move::none())
         bestThread = Threads.get_best_thread();
 
     if (think && !Experience::is_learning_paused() && !bestThread->rootPos.is_chess960()
 										  
 										   
-        && !(bool) Options["Experience Readonly"] && !(bool) Options["UCI_LimitStrength"]
+        && !opts->expReadonly && !opts->limitStrength
 										 
         && bestThread->completedDepth >= Experience::MinDepth)
     {
@@ -441,8 +771,8 @@ void MainThread::search() {
     bestPreviousScore        = bestThread->rootMoves[0].score;
     bestPreviousAverageScore = bestThread->rootMoves[0].averageScore;
 
-    // Send again PV info if we have a new best thread
-    if (bestThread != this)
+    // Send again PV info if we have a new best thread or merged MultiPV lines
+    if (bestThread != this || Threads.rootGroups > 1)
         sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth) << sync_endl;
 
     sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
@@ -459,6 +789,14 @@ void MainThread::search() {
 // consumed, the user stops the search, or the maximum search depth is reached.
 void Thread::search() {
 
+    if (Limits.perft)
+    {
+        perft_worker(this);
+        return;
+    }
+
+    startTime = now_ns();
+
     // Allocate stack with extra size to allow access from (ss - 7) to (ss + 2):
     // (ss - 7) is needed for update_continuation_histories(ss - 1) which accesses (ss - 6),
     // (ss + 2) is needed for initialization of cutOffCnt and killers.
@@ -497,8 +835,9 @@ void Thread::search() {
                 mainThread->iterValue[i] = mainThread->bestPreviousScore;
     }
 
-    size_t multiPV = size_t(Options["MultiPV"]);
-    Skill skill(Options["Skill Level"], Options["UCI_LimitStrength"] ? int(Options["UCI_Elo"]) : 0);
+    const auto opts    = UCI::snapshot();
+    size_t     multiPV = size_t(opts->multiPV);
+    Skill      skill(opts->skillLevel, opts->limitStrength ? opts->elo : 0);
 
     // When playing with strength handicap enable MultiPV search that we will
     // use behind-the-scenes to retrieve a set of possible moves.
@@ -510,8 +849,9 @@ void Thread::search() {
     int searchAgainCounter = 0;
 
     // Iterative deepening loop until requested to stop or the target depth is reached
+    // In MultiPV split mode every thread group must reach the requested depth
     while (++rootDepth < MAX_PLY && !Threads.stop
-           && !(Limits.depth && mainThread && rootDepth > Limits.depth))
+           && !(Limits.depth && (mainThread || Threads.rootGroups > 1) && rootDepth > Limits.depth))
     {
         // Age out PV variability metric
         if (mainThread)
@@ -611,6 +951,12 @@ void Thread::search() {
             // Sort the PV lines searched so far and update the GUI
             std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
+            if (Threads.rootGroups > 1 && pvIdx + 1 == multiPV && !Threads.stop)
+            {
+                completedDepth = rootDepth;
+                publish_root_moves(multiPV);
+            }
+
             if (mainThread && (Threads.stop || pvIdx + 1 == multiPV || Time.elapsed() > 3000))
                 sync_cout << UCI::pv(rootPos, rootDepth) << sync_endl;
         }
@@ -624,18 +970,27 @@ void Thread::search() {
             lastBestMoveDepth = rootDepth;
         }
 
+        // Have we found a "mate in x"? In MultiPV split mode every group leader
+        // checks, on the lines merged from all the groups, as its own are a subset.
+        if (Limits.mate && idx < Threads.rootGroups)
+        {
+            RootMoves          merged;
+            std::vector<Depth> depths;
+            if (Threads.rootGroups > 1)
+                Threads.merge_root_moves(merged, depths);
+
+            const RootMove& best = merged.empty() ? rootMoves[0] : merged[0];
+            if (best.score == best.uciScore
+                && ((best.score >= VALUE_MATE_IN_MAX_PLY
+                     && VALUE_MATE - best.score <= 2 * Limits.mate)
+                    || (best.score != -VALUE_INFINITE && best.score <= VALUE_MATED_IN_MAX_PLY
+                        && VALUE_MATE + best.score <= 2 * Limits.mate)))
+                Threads.stop = true;
+        }
+
         if (!mainThread)
             continue;
 
-        // Have we found a "mate in x"?
-        if (Limits.mate && rootMoves[0].score == rootMoves[0].uciScore
-            && ((rootMoves[0].score >= VALUE_MATE_IN_MAX_PLY
-                 && VALUE_MATE - rootMoves[0].score <= 2 * Limits.mate)
-                || (rootMoves[0].score != -VALUE_INFINITE
-                    && rootMoves[0].score <= VALUE_MATED_IN_MAX_PLY
-                    && VALUE_MATE + rootMoves[0].score <= 2 * Limits.mate)))
-            Threads.stop = true;
-
         // If the skill level is enabled and time is up, pick a sub-optimal best move
         if (skill.enabled() && skill.time_to_pick(rootDepth))
             skill.pick_best(multiPV);
@@ -792,6 +1147,8 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
     excludedMove = ss->excludedMove;
     posKey       = pos.key();
     tte          = TT.probe(posKey, ss->ttHit);
+    thisThread->stats.inc(Search::TT_PROBES);
+    thisThread->stats.inc(Search::TT_HITS, ss->ttHit);
     ttValue   = ss->ttHit ? value_from_tt(tte->value(), ss->ply, pos.rule50_count()) : VALUE_NONE;
     ttMove    = rootNode  ? thisThread->rootMoves[thisThread->pvIdx].pv[0]
               : ss->ttHit ? tte->move()
@@ -805,7 +1162,12 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
 
     // Probe experience data
     const Experience::ExpEntryEx* expEx =
-      !excludedMove && Experience::enabled() ? Experience::probe(pos.key()) : nullptr;
+      !excludedMove && expProbe ? Experience::probe(pos.key()) : nullptr;
+    if (!excludedMove && expProbe)
+    {
+        thisThread->stats.inc(Search::EXP_PROBES);
+        thisThread->stats.inc(Search::EXP_HITS, expEx != nullptr);
+    }
     const Experience::ExpEntryEx* tempExp = expEx;
     const Experience::ExpEntryEx* bestExp = nullptr;
 
@@ -863,7 +1225,7 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
             }
         }
 
-        tempExp = tempExp->next;
+        tempExp = tempExp->next();
     }
 
     // Increment tbHits
@@ -966,7 +1328,7 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
     {
         // Providing the hint that this node's accumulator will be used often
         // brings significant Elo gain (~13 Elo).
-        Eval::NNUE::hint_common_parent_position(pos);
+        hint_common_parent_position(pos, thisThread);
         unadjustedStaticEval = eval = ss->staticEval;
     }
     else if (ss->ttHit)
@@ -976,7 +1338,7 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
         if (eval == VALUE_NONE)
             unadjustedStaticEval = ss->staticEval = eval = evaluate(pos);
         else if (PvNode)
-            Eval::NNUE::hint_common_parent_position(pos);
+            hint_common_parent_position(pos, thisThread);
 
         Value newEval =
           ss->staticEval
@@ -1065,6 +1427,7 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
         ss->continuationHistory = &thisThread->continuationHistory[0][0][NO_PIECE][0];
 
         pos.do_null_move(st);
+        thisThread->stats.inc(Search::NMP_TRIES);
 
         Value nullValue = -search<NonPV>(pos, ss + 1, -beta, -beta + 1, depth - R, !cutNode);
 
@@ -1074,7 +1437,10 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
         if (nullValue >= beta && nullValue < VALUE_TB_WIN_IN_MAX_PLY)
         {
             if (thisThread->nmpMinPly || depth < 16)
+            {
+                thisThread->stats.inc(Search::NMP_CUTOFFS);
                 return nullValue;
+            }
 
             assert(!thisThread->nmpMinPly);  // Recursive verification is not allowed
 
@@ -1087,7 +1453,10 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
             thisThread->nmpMinPly = 0;
 
             if (v >= beta)
+            {
+                thisThread->stats.inc(Search::NMP_CUTOFFS);
                 return nullValue;
+            }
         }
     }
 
@@ -1158,7 +1527,7 @@ Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, boo
                 }
             }
 
-        Eval::NNUE::hint_common_parent_position(pos);
+        hint_common_parent_position(pos, thisThread);
     }
 
 moves_loop:  // When in check, search starts here
@@ -1437,6 +1806,7 @@ moves_loop:  // When in check, search starts here
             // std::clamp has been replaced by a more robust implementation.
             Depth d = std::max(1, std::min(newDepth - r, newDepth + 1));
 
+            thisThread->stats.inc(Search::LMR_SEARCHES);
             value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, d, true);
 
             // Do a full-depth search when reduced LMR search fails high
@@ -1450,7 +1820,10 @@ moves_loop:  // When in check, search starts here
                 newDepth += doDeeperSearch - doShallowerSearch;
 
                 if (newDepth > d)
+                {
+                    thisThread->stats.inc(Search::LMR_RESEARCHES);
                     value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, newDepth, !cutNode);
+                }
 
                 // Post LMR continuation history updates (~1 Elo)
                 int bonus = value <= alpha ? -stat_malus(newDepth)
@@ -1554,6 +1927,7 @@ moves_loop:  // When in check, search starts here
                 if (value >= beta)
                 {
                     ss->cutoffCnt += 1 + !ttMove - (extension >= 2);
+                    thisThread->stats.inc(Search::BETA_CUTOFFS);
                     assert(value >= beta);  // Fail high
                     break;
                 }
@@ -1692,6 +2066,7 @@ Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth) {
     bestMove           = Move::none();
     ss->inCheck        = pos.checkers();
     moveCount          = 0;
+    thisThread->stats.inc(Search::QSEARCH_NODES);
 
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
     if (PvNode && thisThread->selDepth < ss->ply + 1)
@@ -1709,8 +2084,15 @@ Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth) {
     // Step 3. Transposition table and Experience data lookup
     posKey = pos.key();
     tte    = TT.probe(posKey, ss->ttHit);
+    thisThread->stats.inc(Search::TT_PROBES);
+    thisThread->stats.inc(Search::TT_HITS, ss->ttHit);
 
-    const auto* bestExpEntry  = Experience::find_best_entry(posKey);
+    const auto* bestExpEntry  = expProbe ? Experience::find_best_entry(posKey) : nullptr;
+    if (expProbe)
+    {
+        thisThread->stats.inc(Search::EXP_PROBES);
+        thisThread->stats.inc(Search::EXP_HITS, bestExpEntry != nullptr);
+    }
     const bool  prioritizeExp = bestExpEntry && (!ss->ttHit || bestExpEntry->depth > tte->depth());
     const auto  depthToUse    = prioritizeExp ? bestExpEntry->depth : tte->depth();
 
@@ -1904,11 +2286,11 @@ Value qsearch(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth) {
         }
     }
 
-    if (variety && std::abs(UCI::to_cp(bestValue)) < Options["Variety Max Score"])
+    if (variety && std::abs(UCI::to_cp(bestValue)) < varietyMaxScore)
     {
 
         if (bestValue + variety * Hypnos::PawnValue / 100 >= 0
-            && pos.game_ply() / 2 < Options["Variety Max Moves"])
+            && pos.game_ply() / 2 < varietyMaxMoves)
         {
             // Range for variety bonus
             const auto varietyMinRange = thisThread->nodes / 2;
@@ -2010,6 +2392,18 @@ void update_pv(Move* pv, Move move, const Move* childPv) {
 }
 
 
+// Updates the accumulators of a position whose children are about to be evaluated,
+// and counts the work done in the thread statistics
+void hint_common_parent_position(const Position& pos, Thread* thisThread) {
+
+    Eval::NNUE::AccumulatorUpdates updates;
+    Eval::NNUE::hint_common_parent_position(pos, updates);
+
+    thisThread->stats.inc(Search::ACC_UPDATES, updates.incremental);
+    thisThread->stats.inc(Search::ACC_REFRESHES, updates.refreshes);
+}
+
+
 // Updates stats at the end of search() when a bestMove is found
 void update_all_stats(const Position& pos,
                       Stack*          ss,
@@ -2191,13 +2585,24 @@ void MainThread::check_time() {
 // that all (if any) unsearched PV lines are sent using a previous search score.
 string UCI::pv(const Position& pos, Depth depth) {
 
-    std::stringstream ss;
-    TimePoint         elapsed       = Time.elapsed() + 1;
-    const RootMoves&  rootMoves     = pos.this_thread()->rootMoves;
-    size_t            pvIdx         = pos.this_thread()->pvIdx;
-    size_t            multiPV       = std::min(size_t(Options["MultiPV"]), rootMoves.size());
-    uint64_t          nodesSearched = Threads.nodes_searched();
-    uint64_t          tbHits        = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
+    std::stringstream  ss;
+    TimePoint          elapsed = Time.elapsed() + 1;
+    RootMoves          merged;
+    std::vector<Depth> depths;
+
+    // In MultiPV split mode each thread group owns only a subset of the root
+    // moves, so the lines published by all the groups are merged and every
+    // line is reported at the depth it was searched to.
+    if (Threads.rootGroups > 1)
+        Threads.merge_root_moves(merged, depths);
+
+    const bool       split         = Threads.rootGroups > 1 && !merged.empty();
+    const RootMoves& rootMoves     = split ? merged : pos.this_thread()->rootMoves;
+    size_t           pvIdx         = split ? rootMoves.size() : pos.this_thread()->pvIdx;
+    const auto       opts          = UCI::snapshot();
+    size_t           multiPV       = std::min(size_t(opts->multiPV), rootMoves.size());
+    uint64_t         nodesSearched = Threads.nodes_searched();
+    uint64_t         tbHits        = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
 
     for (size_t i = 0; i < multiPV; ++i)
     {
@@ -2206,7 +2611,7 @@ string UCI::pv(const Position& pos, Depth depth) {
         if (depth == 1 && !updated && i > 0)
             continue;
 
-        Depth d = updated ? depth : std::max(1, depth - 1);
+        Depth d = split ? depths[i] : updated ? depth : std::max(1, depth - 1);
         Value v = updated ? rootMoves[i].uciScore : rootMoves[i].previousScore;
 
         if (v == -VALUE_INFINITE)
@@ -2222,7 +2627,7 @@ string UCI::pv(const Position& pos, Depth depth) {
            << " depth " << d << " seldepth " << rootMoves[i].selDepth << " multipv " << i + 1
            << " score " << UCI::value(v);
 
-        if (Options["UCI_ShowWDL"])
+        if (opts->showWDL)
             ss << UCI::wdl(v, pos.game_ply());
 
         if (i == pvIdx && !tb && updated)  // tablebase- and previous-scores are exact
@@ -2273,10 +2678,11 @@ bool RootMove::extract_ponder_from_tt(Position& pos) {
 
 void Tablebases::rank_root_moves(Position& pos, Search::RootMoves& rootMoves) {
 
+    const auto opts    = UCI::snapshot();
     RootInTB           = false;
-    UseRule50          = bool(Options["Syzygy50MoveRule"]);
-    ProbeDepth         = int(Options["SyzygyProbeDepth"]);
-    Cardinality        = int(Options["SyzygyProbeLimit"]);
+    UseRule50          = opts->syzygy50MoveRule;
+    ProbeDepth         = opts->syzygyProbeDepth;
+    Cardinality        = opts->syzygyProbeLimit;
     bool dtz_available = true;
 
     // Tables with fewer pieces than SyzygyProbeLimit are searched with
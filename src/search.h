@@ -19,6 +19,7 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
 
@@ -105,6 +106,55 @@ struct LimitsType {
 
 extern LimitsType Limits;
 
+// Time spent in each phase of the last Search::clear(), in nanoseconds, see
+// the 'clearlatency' command.
+struct ClearTimes {
+    int64_t tt, histories, tablebases, experience;
+};
+
+extern ClearTimes LastClear;
+
+
+// Telemetry counters collected by every search thread
+enum StatsCounter : int {
+    TT_PROBES,
+    TT_HITS,
+    EXP_PROBES,
+    EXP_HITS,
+    EVAL_BIG,
+    EVAL_SMALL,
+    EVAL_PSQT_ONLY,
+    ACC_REFRESHES,
+    ACC_UPDATES,
+    NMP_TRIES,
+    NMP_CUTOFFS,
+    LMR_SEARCHES,
+    LMR_RESEARCHES,
+    QSEARCH_NODES,
+    BETA_CUTOFFS,
+    TB_PROBES,
+    TB_CACHE_HITS,
+    STATS_COUNTER_NB
+};
+
+// SearchStats holds the counters of one thread. They are written only by
+// their owner, so an increment is a relaxed load and store rather than a
+// locked read-modify-write, while other threads may read them at any time.
+struct SearchStats {
+
+    void inc(StatsCounter c, uint64_t n = 1) {
+        counters[c].store(counters[c].load(std::memory_order_relaxed) + n,
+                          std::memory_order_relaxed);
+    }
+    uint64_t get(StatsCounter c) const { return counters[c].load(std::memory_order_relaxed); }
+    void     clear() {
+        for (auto& c : counters)
+            c.store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counters[STATS_COUNTER_NB] = {};
+};
+
 void init();
 void clear();
 
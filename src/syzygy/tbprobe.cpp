@@ -20,6 +20,7 @@
 
 #include <sys/stat.h>
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cassert>
 #include <cstdint>
@@ -29,9 +30,11 @@
 #include <fstream>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -41,6 +44,7 @@
 #include "../movegen.h"
 #include "../position.h"
 #include "../search.h"
+#include "../thread.h"
 #include "../types.h"
 #include "../uci.h"
 
@@ -353,6 +357,8 @@ struct TBTable {
     static constexpr int Sides = Type == WDL ? 2 : 1;
 
     std::atomic_bool ready;
+    std::mutex       mutex;  // Serializes the first access, see mapped()
+    std::string      name;   // Like "KRvK"
     void*            baseAddress;
     uint8_t*         map;
     uint64_t         mapping;
@@ -385,6 +391,7 @@ TBTable<WDL>::TBTable(const std::string& code) :
     StateInfo st;
     Position  pos;
 
+    name       = code;
     key        = pos.set(code, WHITE, &st).material_key();
     pieceCount = pos.count<ALL_PIECES>();
     hasPawns   = pos.pieces(PAWN);
@@ -411,6 +418,7 @@ TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) :
     TBTable() {
 
     // Use the corresponding WDL table to avoid recalculating all from scratch
+    name            = wdl.name;
     key             = wdl.key;
     key2            = wdl.key2;
     pieceCount      = wdl.pieceCount;
@@ -489,10 +497,134 @@ class TBTables {
     }
     size_t size() const { return wdlTable.size(); }
     void   add(const std::vector<PieceType>& pieces);
+
+    // Calls f(wdl, dtz) for each pair of tables
+    template<typename F>
+    void for_each(F f) {
+        for (size_t i = 0; i < wdlTable.size(); ++i)
+            f(wdlTable[i], dtzTable[i]);
+    }
 };
 
 TBTables TBTables;
 
+// class ProbeCache is a lockless cache of probe_wdl() and probe_dtz() results
+// shared by all threads. Each slot is a single 64-bit word, read and written
+// atomically: the lower 32 bits of the key, which are not used to pick the slot,
+// verify it in the upper half of the word, the lower half packs the DTZ value,
+// the WDL score and the probe states. A lost race only loses a cached result.
+// Results do not depend on the 50-move counter, so the cache is keyed by the raw
+// position key rather than Position::key().
+class ProbeCache {
+
+    static constexpr uint64_t HasWDL = 1, HasDTZ = 2;
+
+    std::unique_ptr<std::atomic<uint64_t>[]> table;
+    size_t                                   slotCount = 0;
+
+    std::atomic<uint64_t>& slot(Key key) const { return table[mul_hi64(key, slotCount)]; }
+
+    // The slot is picked by the upper bits of the key, so verify it with the lower ones
+    static uint64_t tag(Key key) { return uint64_t(uint32_t(key)) << 32; }
+
+    // Returns the slot data if it belongs to the given key, zero otherwise
+    uint64_t read(Key key) const {
+        if (!slotCount)
+            return 0;
+
+        uint64_t data = slot(key).load(std::memory_order_relaxed);
+        return (data & ~uint64_t(0xFFFFFFFF)) == tag(key) ? data : 0;
+    }
+
+   public:
+    void resize(size_t mbSize) {
+        size_t newCount = std::min(mbSize, size_t(4096)) * 1024 * 1024 / sizeof(uint64_t);
+        if (newCount != slotCount)
+        {
+            table     = newCount ? std::make_unique<std::atomic<uint64_t>[]>(newCount) : nullptr;
+            slotCount = newCount;
+        }
+    }
+
+    void clear() {
+        for (size_t i = 0; i < slotCount; ++i)
+            table[i].store(0, std::memory_order_relaxed);
+    }
+
+    bool probe_wdl(Key key, WDLScore* wdl, ProbeState* result) const {
+        uint64_t data = read(key);
+        if (!(data & HasWDL))
+            return false;
+
+        *wdl    = WDLScore(int((data >> 8) & 7) - 2);
+        *result = ProbeState(int((data >> 2) & 3) - 1);
+        return true;
+    }
+
+    bool probe_dtz(Key key, int* dtz, ProbeState* result) const {
+        uint64_t data = read(key);
+        if (!(data & HasDTZ))
+            return false;
+
+        *dtz    = int16_t(data >> 16);
+        *result = ProbeState(int((data >> 4) & 3) - 1);
+        return true;
+    }
+
+    void store_wdl(Key key, WDLScore wdl, ProbeState result) {
+        if (!slotCount)
+            return;
+
+        uint64_t data = read(key) & ~uint64_t(0x70C);
+        data |= tag(key) | uint64_t(wdl + 2) << 8 | uint64_t(result + 1) << 2 | HasWDL;
+        slot(key).store(data, std::memory_order_relaxed);
+    }
+
+    void store_dtz(Key key, int dtz, ProbeState result) {
+        if (!slotCount)
+            return;
+
+        uint64_t data = read(key) & ~uint64_t(0xFFFF0030);
+        data |= tag(key) | uint64_t(uint16_t(dtz)) << 16 | uint64_t(result + 1) << 4
+              | HasDTZ;
+        slot(key).store(data, std::memory_order_relaxed);
+    }
+};
+
+ProbeCache ProbeCache;
+
+// class WarmUpThread runs the background part of Tablebases::warm_up(). A new
+// warm-up, a reload of the tables and the exit stop and join the running one.
+class WarmUpThread {
+
+    std::thread      thread;
+    std::atomic_bool stopRequested = false;
+
+   public:
+    template<typename F>
+    void start(F f) {
+        stop();
+        stopRequested = false;
+        thread        = std::thread(f);
+    }
+
+    void stop() {
+        stopRequested = true;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    bool stopped() const { return stopRequested.load(std::memory_order_relaxed); }
+
+    ~WarmUpThread() { stop(); }
+};
+
+WarmUpThread WarmUpThread;
+
+// Root material of the last warm-up. Background warm-ups are skipped while it does
+// not change, so it is reset when init() or clear() stop the running warm-up.
+Key WarmedUpMaterial;
+
 // If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
 // are created and added to the lists and hash table. Called at init time.
 void TBTables::add(const std::vector<PieceType>& pieces) {
@@ -1191,18 +1323,17 @@ void set(T& e, uint8_t* data) {
 // If the TB file corresponding to the given position is already memory-mapped
 // then return its base address, otherwise, try to memory map and init it. Called
 // at every probe, memory map, and init only at first access. Function is thread
-// safe and can be called concurrently.
+// safe and can be called concurrently: the lock is per table, so first accesses
+// to different tables do not wait for each other.
 template<TBType Type>
 void* mapped(TBTable<Type>& e, const Position& pos) {
 
-    static std::mutex mutex;
-
     // Use 'acquire' to avoid a thread reading 'ready' == true while
     // another is still working. (compiler reordering may cause this).
     if (e.ready.load(std::memory_order_acquire))
         return e.baseAddress;  // Could be nullptr if file does not exist
 
-    std::scoped_lock<std::mutex> lk(mutex);
+    std::scoped_lock<std::mutex> lk(e.mutex);
 
     if (e.ready.load(std::memory_order_relaxed))  // Recheck under lock
         return e.baseAddress;
@@ -1241,6 +1372,92 @@ Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw)
     return do_probe_table(pos, entry, wdl, result);
 }
 
+// Piece counts of a material signature, indexed by color and piece type
+using Material = std::array<std::array<int, PIECE_TYPE_NB>, COLOR_NB>;
+
+Material material_of(const Position& pos) {
+
+    Material m{};
+    for (Color c : {WHITE, BLACK})
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+            m[c][pt] = popcount(pos.pieces(c, pt));
+
+    return m;
+}
+
+// Whether the material of a table can arise from the root material through
+// captures and promotions: every extra piece must come from a missing pawn.
+bool reachable(const Material& root, const Material& table) {
+
+    for (Color c : {WHITE, BLACK})
+    {
+        int promotions = 0;
+        for (PieceType pt = KNIGHT; pt <= QUEEN; ++pt)
+            promotions += std::max(table[c][pt] - root[c][pt], 0);
+
+        if (table[c][PAWN] + promotions > root[c][PAWN])
+            return false;
+    }
+
+    return true;
+}
+
+// Maps the table and asks the OS to read the whole file ahead in the background.
+// Returns the size of the file, zero if it could not be mapped.
+template<TBType Type>
+size_t will_need(TBTable<Type>& e, const Position& pos) {
+
+    if (!mapped(e, pos))
+        return 0;
+
+#ifndef _WIN32
+    #if defined(MADV_WILLNEED)
+    madvise(e.baseAddress, e.mapping, MADV_WILLNEED);
+    #endif
+    return e.mapping;  // File size
+#else
+    return 1;
+#endif
+}
+
+// Reads one byte per page of the sparse indices and block lengths of a mapped
+// table, the data read by every probe before decompressing a block. Returns the
+// number of bytes covered. Every page may have to be read from the disk, so a
+// stop of the warm-up is checked before each one.
+template<TBType Type>
+size_t touch_index(TBTable<Type>& e) {
+
+    if (!e.ready.load(std::memory_order_acquire) || !e.baseAddress)
+        return 0;
+
+    const int  sides   = TBTable<Type>::Sides == 2 && (e.key != e.key2) ? 2 : 1;
+    const File maxFile = e.hasPawns ? FILE_D : FILE_A;
+
+    size_t           bytes = 0;
+    volatile uint8_t sink  = 0;
+
+    auto touch = [&](const void* p, size_t size) {
+        for (size_t i = 0; i < size; i += 4096)
+        {
+            if (WarmUpThread.stopped())
+                return;
+
+            sink = sink + ((const uint8_t*) p)[i];
+            bytes += std::min<size_t>(size - i, 4096);
+        }
+    };
+
+    for (File f = FILE_A; f <= maxFile; ++f)
+        for (int i = 0; i < sides; i++)
+        {
+            PairsData* d = e.get(i, f);
+            touch(d->sparseIndex, d->sparseIndexSize * sizeof(SparseEntry));
+            touch(d->blockLength, d->blockLengthSize * sizeof(uint16_t));
+        }
+
+    return bytes;
+}
+
 // For a position where the side to move has a winning capture it is not necessary
 // to store a winning value so the generator treats such positions as "don't care"
 // and tries to assign to it a value that improves the compression ratio. Similarly,
@@ -1314,17 +1531,108 @@ WDLScore search(Position& pos, ProbeState* result) {
     return *result = OK, value;
 }
 
+int probe_dtz_uncached(Position& pos, ProbeState* result);
+
+// Probes go through the probe cache. Only the probes asked by the search, with
+// Counted, are counted in the thread stats: the probes made while resolving one
+// of them are not, so that the cache hit rate is the one seen by the search.
+template<bool Counted>
+WDLScore cached_probe_wdl(Position& pos, ProbeState* result) {
+
+    Thread*  th  = pos.this_thread();
+    Key      key = pos.state()->key;
+    WDLScore wdl;
+
+    if (Counted && th)
+        th->stats.inc(Search::TB_PROBES);
+
+    if (ProbeCache.probe_wdl(key, &wdl, result))
+    {
+        if (Counted && th)
+            th->stats.inc(Search::TB_CACHE_HITS);
+        return wdl;
+    }
+
+    *result = OK;
+    wdl     = search<false>(pos, result);
+
+    if (*result != FAIL)
+        ProbeCache.store_wdl(key, wdl, *result);
+
+    return wdl;
+}
+
+template<bool Counted>
+int cached_probe_dtz(Position& pos, ProbeState* result) {
+
+    Thread* th  = pos.this_thread();
+    Key     key = pos.state()->key;
+    int     dtz;
+
+    if (Counted && th)
+        th->stats.inc(Search::TB_PROBES);
+
+    if (ProbeCache.probe_dtz(key, &dtz, result))
+    {
+        if (Counted && th)
+            th->stats.inc(Search::TB_CACHE_HITS);
+        return dtz;
+    }
+
+    dtz = probe_dtz_uncached(pos, result);
+
+    if (*result != FAIL)
+        ProbeCache.store_dtz(key, dtz, *result);
+
+    return dtz;
+}
+
 }  // namespace
 
 
+// Waits for the background warm-up to stop, so that the caller can change data
+// that it reads, like the slider attack tables. The next warm-up starts anew.
+void Tablebases::stop_warm_up() {
+
+    WarmUpThread.stop();
+    WarmedUpMaterial = 0;
+}
+
+
+// Called on a new game. The files are only scanned and mapped again if 'paths'
+// differs from the one in use, otherwise just the probe cache is emptied.
+void Tablebases::clear(const std::string& paths) {
+
+    if (paths != TBFile::Paths)
+    {
+        init(paths);
+        return;
+    }
+
+    stop_warm_up();
+    ProbeCache.clear();
+}
+
+
+// Called after a change to the "SyzygyCacheSize" UCI option. No cache is
+// allocated while there are no tablebase paths.
+void Tablebases::resize_cache(size_t mbSize) {
+    ProbeCache.resize(TBFile::Paths.empty() || TBFile::Paths == "<empty>" ? 0 : mbSize);
+    ProbeCache.clear();
+}
+
 // Called at startup and after every change to
 // "SyzygyPath" UCI option to (re)create the various tables. It is not thread
 // safe, nor it needs to be.
 void Tablebases::init(const std::string& paths) {
 
+    stop_warm_up();
+
+    TBFile::Paths = paths;
+    resize_cache(size_t(Options["SyzygyCacheSize"]));
+
     TBTables.clear();
     MaxCardinality = 0;
-    TBFile::Paths  = paths;
 
     if (paths.empty() || paths == "<empty>")
         return;
@@ -1479,8 +1787,9 @@ void Tablebases::init(const std::string& paths) {
 //  2 : win
 WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
 
-    *result = OK;
-    return search<false>(pos, result);
+    INSTRUMENT(INS_TB_PROBE_WDL);
+
+    return cached_probe_wdl<true>(pos, result);
 }
 
 // Probe the DTZ table for a particular position.
@@ -1511,6 +1820,14 @@ WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
 // then do not accept moves leading to dtz + 50-move-counter == 100.
 int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
 
+    return cached_probe_dtz<true>(pos, result);
+}
+
+namespace {
+
+// Tablebases::probe_dtz() without the probe cache
+int probe_dtz_uncached(Position& pos, ProbeState* result) {
+
     *result      = OK;
     WDLScore wdl = search<true>(pos, result);
 
@@ -1545,7 +1862,8 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
         // otherwise we will get the dtz of the next move sequence. Search the
         // position after the move to get the score sign (because even in a
         // winning position we could make a losing capture or go for a draw).
-        dtz = zeroing ? -dtz_before_zeroing(search<false>(pos, result)) : -probe_dtz(pos, result);
+        dtz = zeroing ? -dtz_before_zeroing(search<false>(pos, result))
+                      : -cached_probe_dtz<false>(pos, result);
 
         // If the move mates, force minDTZ to 1
         if (dtz == 1 && pos.checkers() && MoveList<LEGAL>(pos).size() == 0)
@@ -1570,6 +1888,90 @@ int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
     return minDTZ == 0xFFFF ? -1 : minDTZ;
 }
 
+}  // namespace
+
+
+// Prepares the tables which may be probed below the given position: the WDL and
+// DTZ tables of every material reachable from the root are mapped and the OS is
+// asked to read them ahead, so the search does not stall on the first probes.
+// With 'touch', their index blocks are then read on a background thread. With
+// 'background', all the work is done there and nothing is reported.
+void Tablebases::warm_up(const Position& pos, bool touch, bool background) {
+
+    if (background && pos.material_key() == WarmedUpMaterial)
+        return;
+
+    WarmedUpMaterial = pos.material_key();
+
+    Material root = material_of(pos);
+
+    std::vector<std::pair<TBTable<WDL>*, TBTable<DTZ>*>> tables;
+
+    TBTables.for_each([&](TBTable<WDL>& wdl, TBTable<DTZ>& dtz) {
+        if (wdl.pieceCount > pos.count<ALL_PIECES>())
+            return;
+
+        StateInfo st;
+        Position  p;
+        Material  m = material_of(p.set(wdl.name, WHITE, &st));
+
+        if (reachable(root, m) || reachable(root, {m[BLACK], m[WHITE]}))
+            tables.emplace_back(&wdl, &dtz);
+    });
+
+    auto map = [tables](bool async) {
+        size_t count = 0, bytes = 0;
+
+        for (auto [wdl, dtz] : tables)
+        {
+            if (async && WarmUpThread.stopped())
+                break;
+
+            StateInfo st;
+            Position  p;
+            p.set(wdl->name, WHITE, &st);
+
+            size_t size = will_need(*wdl, p);
+            count += size > 0;
+            bytes += size + will_need(*dtz, p);
+        }
+
+        return std::make_pair(count, bytes);
+    };
+
+    auto touchIndex = [tables]() {
+        for (auto [wdl, dtz] : tables)
+        {
+            if (WarmUpThread.stopped())
+                break;
+
+            touch_index(*wdl);
+            touch_index(*dtz);
+        }
+    };
+
+    if (background)
+    {
+        WarmUpThread.start([=]() {
+            map(true);
+            if (touch)
+                touchIndex();
+        });
+        return;
+    }
+
+    TimePoint start     = now();
+    auto [count, bytes] = map(false);
+    TimePoint elapsed   = now() - start;
+
+    if (touch)
+        WarmUpThread.start(touchIndex);
+
+    sync_cout << "info string Syzygy warm-up: " << count << " of " << tables.size()
+              << " reachable tables mapped, " << Utility::format_bytes(bytes, 2)
+              << " read ahead in " << elapsed << " ms" << (touch ? ", touching indices" : "")
+              << sync_endl;
+}
 
 // Use the DTZ tables to rank root moves.
 //
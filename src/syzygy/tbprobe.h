@@ -19,6 +19,7 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <cstddef>
 #include <string>
 
 #include "../search.h"
@@ -48,6 +49,10 @@ enum ProbeState {
 extern int MaxCardinality;
 
 void     init(const std::string& paths);
+void     clear(const std::string& paths);
+void     resize_cache(size_t mbSize);
+void     warm_up(const Position& pos, bool touch, bool background);
+void     stop_warm_up();
 WDLScore probe_wdl(Position& pos, ProbeState* result);
 int      probe_dtz(Position& pos, ProbeState* result);
 bool     root_probe(Position& pos, Search::RootMoves& rootMoves);
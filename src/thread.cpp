@@ -71,6 +71,7 @@ void Thread::clear() {
     captureHistory.fill(0);
     pawnHistory.fill(0);
     correctionHistory.fill(0);
+    stats.clear();
 
     for (bool inCheck : {false, true})
         for (StatsType c : {NoCaptures, Captures})
@@ -84,11 +85,28 @@ void Thread::clear() {
 void Thread::start_searching() {
     mutex.lock();
     searching = true;
-    mutex.unlock();   // Unlock before notifying saves a few CPU-cycles
+    mutex.unlock();  // Unlock before notifying saves a few CPU-cycles
+    Threads.searchEpoch.fetch_add(1, std::memory_order_release);  // Release spinning threads
     cv.notify_one();  // Wake up the thread in idle_loop()
 }
 
 
+// Wakes up the thread to run 'f' instead of a search, so that the job runs on
+// the thread, and NUMA node, that will use the memory it touches. Wait for it
+// with wait_for_search_finished().
+void Thread::run_custom_job(std::function<void()> f) {
+
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [&] { return !searching; });
+        jobFunc   = std::move(f);
+        searching = true;
+    }
+    Threads.searchEpoch.fetch_add(1, std::memory_order_release);
+    cv.notify_one();
+}
+
+
 // Blocks on the condition variable
 // until the thread has finished searching.
 void Thread::wait_for_search_finished() {
@@ -98,6 +116,46 @@ void Thread::wait_for_search_finished() {
 }
 
 
+// Returns true if the thread is running a search, pondering included
+bool Thread::is_searching() {
+
+    std::lock_guard<std::mutex> lk(mutex);
+    return searching;
+}
+
+
+// Busy-waits for at most 'spinTime' microseconds, or until start_searching()
+// has been called for this thread. Each start_searching() bumps the pool-wide
+// epoch, so a spinning thread only touches its mutex when something changed.
+void Thread::spin_wait(int64_t spinTime) {
+
+    const int64_t deadline = now_ns() + spinTime * 1000;
+    uint64_t      epoch    = Threads.searchEpoch.load(std::memory_order_acquire);
+
+    for (int iter = 1;; ++iter)
+    {
+        if (Threads.searchEpoch.load(std::memory_order_acquire) != epoch)
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            if (searching)
+                return;
+
+            epoch = Threads.searchEpoch.load(std::memory_order_relaxed);
+        }
+
+        // Reading the clock is much slower than the epoch, so do it sparingly
+        if (!(iter & 63) && now_ns() > deadline)
+            return;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_ia32_pause();
+#elif defined(_MSC_VER) && defined(_M_X64)
+        _mm_pause();
+#endif
+    }
+}
+
+
 // Thread gets parked here, blocked on the
 // condition variable, when it has no work to do.
 
@@ -116,6 +174,16 @@ void Thread::idle_loop() {
         std::unique_lock<std::mutex> lk(mutex);
         searching = false;
         cv.notify_one();  // Wake up anyone waiting for search finished
+
+        // In low-latency mode stay awake for a while, so that the next 'go'
+        // does not have to pay for a kernel wake-up of every thread.
+        if (const int64_t spinTime = Threads.spinTime.load(std::memory_order_relaxed))
+        {
+            lk.unlock();
+            spin_wait(spinTime);
+            lk.lock();
+        }
+
         cv.wait(lk, [&] { return searching; });
 
         if (exit)
@@ -123,10 +191,38 @@ void Thread::idle_loop() {
 
         lk.unlock();
 
-        search();
+        if (jobFunc)
+        {
+            std::function<void()> job = std::move(jobFunc);
+            jobFunc                   = nullptr;
+            job();
+        }
+        else
+            search();
     }
 }
 
+// Blocks the main thread at the end of a ponder or infinite search, until the
+// GUI sends "stop" or "ponderhit". Must be paired with notify_stop_or_ponderhit()
+// by whoever changes Threads.stop or ponder.
+void MainThread::wait_for_stop_or_ponderhit() {
+
+    std::unique_lock<std::mutex> lk(ponderMutex);
+    ponderCv.wait(lk, [&] { return Threads.stop || !(ponder || Search::Limits.infinite); });
+}
+
+
+// Wakes up the main thread waiting in wait_for_stop_or_ponderhit(). Taking the
+// mutex ensures the waiter either sees the new state or is already blocked.
+void MainThread::notify_stop_or_ponderhit() {
+
+    {
+        std::lock_guard<std::mutex> lk(ponderMutex);
+    }
+    ponderCv.notify_one();
+}
+
+
 // Creates/destroys threads to match the requested number.
 // Created and launched threads will immediately go to sleep in idle_loop.
 // Upon resizing, threads are recreated to allow for binding if necessary.
@@ -160,8 +256,12 @@ void ThreadPool::set(size_t requested) {
 // Sets threadPool data to initial values
 void ThreadPool::clear() {
 
+    // Each thread zeroes its own histories, in parallel and on its NUMA node
+    for (Thread* th : threads)
+        th->run_custom_job([th]() { th->clear(); });
+
     for (Thread* th : threads)
-        th->clear();
+        th->wait_for_search_finished();
 
     main()->callsCnt                 = 0;
     main()->bestPreviousScore        = VALUE_INFINITE;
@@ -179,6 +279,7 @@ void ThreadPool::start_thinking(Position&                 pos,
 
     main()->wait_for_search_finished();
 
+    goTime                  = now_ns();
     main()->stopOnPonderhit = stop = false;
     increaseDepth                  = true;
     main()->ponder                 = ponderMode;
@@ -193,6 +294,22 @@ void ThreadPool::start_thinking(Position&                 pos,
     if (!rootMoves.empty())
         Tablebases::rank_root_moves(pos, rootMoves);
 
+    rootMovesTime = now_ns();
+
+    // In MultiPV split mode the root moves are dealt round-robin to groups of
+    // threads, so each group only computes the lines of its own moves. This is
+    // restricted to searches that never probe the books nor use the clock, see
+    // MainThread::search(). A ponder search is not split since it turns into a
+    // timed search on ponderhit, whose stop logic only follows the main thread.
+    const auto   opts     = UCI::snapshot();
+    const size_t multiPV  = size_t(opts->multiPV);
+    const bool   handicap = opts->skillLevel < 20 || opts->limitStrength;
+
+    rootGroups = 1;
+    if (opts->multiPVSplit && multiPV > 1 && !handicap
+        && (limits.infinite || limits.mate || limits.depth || limits.nodes))
+        rootGroups = std::max(size_t(1), std::min({threads.size(), multiPV, rootMoves.size()}));
+
     // After ownership transfer 'states' becomes empty, so if we stop the search
     // and call 'go' again without setting a new position states.get() == nullptr.
     assert(states.get() || setupStates.get());
@@ -200,21 +317,34 @@ void ThreadPool::start_thinking(Position&                 pos,
     if (states.get())
         setupStates = std::move(states);  // Ownership transfer, states is now empty
 
-    // We use Position::set() to set root position across threads. But there are
-    // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
-    // be deduced from a fen string, so set() clears them and they are set from
-    // setupStates->back() later. The rootState is per thread, earlier states are shared
-    // since they are read-only.
+    // We use Position::set() to copy the root position to every thread. But there
+    // are some StateInfo fields (previous, pliesFromNull, capturedPiece) that are
+    // not copied, so set() clears them and they are set from setupStates->back()
+    // later. The rootState is per thread, earlier states are shared since they are
+    // read-only. The root moves are generated and ranked only once, above.
+    const int simpleEval = Eval::simple_eval(pos, pos.side_to_move());
+
     for (Thread* th : threads)
     {
         th->nodes = th->tbHits = th->nmpMinPly = th->bestMoveChanges = 0;
         th->rootDepth = th->completedDepth = 0;
         th->rootMoves                      = rootMoves;
-        th->rootPos.set(pos.fen(), pos.is_chess960(), &th->rootState, th);
+        th->publishedMoves.clear();
+        th->publishedDepth = 0;
+
+        if (rootGroups > 1)
+        {
+            th->rootMoves.clear();
+            for (size_t i = th->id() % rootGroups; i < rootMoves.size(); i += rootGroups)
+                th->rootMoves.push_back(rootMoves[i]);
+        }
+
+        th->rootPos.set(pos, &th->rootState, th);
         th->rootState      = setupStates->back();
-        th->rootSimpleEval = Eval::simple_eval(pos, pos.side_to_move());
+        th->rootSimpleEval = simpleEval;
     }
 
+    setupTime = now_ns();
     main()->start_searching();
 }
 
@@ -256,6 +386,55 @@ Thread* ThreadPool::get_best_thread() const {
 }
 
 
+// Copies the first 'count' root moves, as sorted after a completed iteration,
+// to where merge_root_moves() can read them without racing with the search.
+void Thread::publish_root_moves(size_t count) {
+
+    std::lock_guard<std::mutex> lk(publishMutex);
+    publishedMoves.assign(rootMoves.begin(), rootMoves.begin() + count);
+    publishedDepth = completedDepth;
+}
+
+
+// Builds the MultiPV output in split mode: for every thread group, takes the
+// lines published by its deepest thread and sorts them all by score. 'depths'
+// receives the depth at which each of the returned lines was searched.
+void ThreadPool::merge_root_moves(Search::RootMoves& merged, std::vector<Depth>& depths) const {
+
+    std::vector<std::pair<Search::RootMove, Depth>> lines;
+
+    for (size_t group = 0; group < rootGroups; ++group)
+    {
+        Thread* best      = nullptr;
+        Depth   bestDepth = 0;
+
+        // The helpers keep publishing while we read, so take each thread's lock
+        for (Thread* th : threads)
+            if (th->id() % rootGroups == group)
+            {
+                std::lock_guard<std::mutex> lk(th->publishMutex);
+                if (!best || th->publishedDepth > bestDepth)
+                    best = th, bestDepth = th->publishedDepth;
+            }
+
+        std::lock_guard<std::mutex> lk(best->publishMutex);
+        for (const auto& rm : best->publishedMoves)
+            lines.emplace_back(rm, best->publishedDepth);
+    }
+
+    std::stable_sort(lines.begin(), lines.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    merged.clear();
+    depths.clear();
+    for (auto& [rm, depth] : lines)
+    {
+        merged.push_back(std::move(rm));
+        depths.push_back(depth);
+    }
+}
+
+
 // Start non-main threads
 
 void ThreadPool::start_searching() {
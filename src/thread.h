@@ -23,6 +23,7 @@
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <mutex>
 #include <vector>
 
@@ -42,6 +43,9 @@ class Thread {
     size_t                  idx;
     bool                    exit = false, searching = true;  // Set before starting std::thread
     NativeThread            stdThread;
+    std::function<void()>   jobFunc;  // Run by idle_loop() instead of search() if set
+
+    void spin_wait(int64_t spinTime);
 
    public:
     explicit Thread(size_t);
@@ -50,13 +54,18 @@ class Thread {
     void         clear();
     void         idle_loop();
     void         start_searching();
+    void         run_custom_job(std::function<void()> f);
     void         wait_for_search_finished();
+    bool         is_searching();
+    void         publish_root_moves(size_t count);
     size_t       id() const { return idx; }
 
     size_t                pvIdx, pvLast;
     std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
     int                   selDepth, nmpMinPly;
     Value                 bestValue;
+    int64_t               startTime;  // now_ns() when search() was entered, see 'golatency'
+    Search::SearchStats   stats;
 
     int optimism[COLOR_NB];
 
@@ -72,6 +81,12 @@ class Thread {
     ContinuationHistory   continuationHistory[2][2];
     PawnHistory           pawnHistory;
     CorrectionHistory     correctionHistory;
+
+    // MultiPV split mode: the first lines of the last completed iteration,
+    // readable by the main thread while this thread keeps searching.
+    std::mutex        publishMutex;
+    Search::RootMoves publishedMoves;
+    Depth             publishedDepth;
 };
 
 
@@ -82,14 +97,21 @@ struct MainThread: public Thread {
 
     void search() override;
     void check_time();
+    void wait_for_stop_or_ponderhit();
+    void notify_stop_or_ponderhit();
 
     double           previousTimeReduction;
     Value            bestPreviousScore;
     Value            bestPreviousAverageScore;
     Value            iterValue[4];
     int              callsCnt;
+    int64_t          wakeTime;  // now_ns() when MainThread::search() was entered
     bool             stopOnPonderhit;
     std::atomic_bool ponder;
+
+   private:
+    std::mutex              ponderMutex;
+    std::condition_variable ponderCv;
 };
 
 
@@ -108,9 +130,22 @@ struct ThreadPool {
     Thread*     get_best_thread() const;
     void        start_searching();
     void        wait_for_search_finished() const;
+    void        merge_root_moves(Search::RootMoves&, std::vector<Depth>&) const;
 
     std::atomic_bool stop, increaseDepth;
 
+    // Number of thread groups the root moves are split across in MultiPV split
+    // mode. Thread 'idx' searches the moves of group 'idx % rootGroups' only.
+    size_t rootGroups = 1;
+
+    // Low-latency pool mode: idle threads spin for up to 'spinTime' microseconds
+    // after a search, watching 'searchEpoch', before blocking on their condition
+    // variable. 'goTime' is the now_ns() timestamp of the last start_thinking(),
+    // the other timestamps mark the end of its phases, see 'golatency'.
+    std::atomic<int64_t>  spinTime;
+    std::atomic<uint64_t> searchEpoch;
+    int64_t               goTime, rootMovesTime, setupTime;
+
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
     auto end() noexcept { return threads.end(); }
@@ -41,9 +41,10 @@ void TimeManagement::init(Search::LimitsType& limits, Color us, int ply) {
     {
         return;
     }
-    TimePoint minThinkingTime = TimePoint(Options["Minimum Thinking Time"]);
-    TimePoint moveOverhead = TimePoint(Options["MoveOverhead"]);
-    TimePoint npmsec       = TimePoint(Options["nodestime"]);
+    const auto opts            = UCI::snapshot();
+    TimePoint  minThinkingTime = TimePoint(opts->minThinkingTime);
+    TimePoint  moveOverhead    = TimePoint(opts->moveOverhead);
+    TimePoint  npmsec          = TimePoint(opts->nodestime);
 
     // optScale is a percentage of available time to use for the current move.
     // maxScale is a multiplier applied to optimumTime.
@@ -108,7 +109,7 @@ void TimeManagement::init(Search::LimitsType& limits, Color us, int ply) {
     maximumTime =
       TimePoint(std::min(0.825 * limits.time[us] - moveOverhead, maxScale * optimumTime)) - 10;
 
-    if (Options["Ponder"])
+    if (opts->ponder)
         optimumTime += optimumTime / 4;
 }
 
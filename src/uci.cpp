@@ -21,15 +21,21 @@
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <charconv>
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <deque>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "benchmark.h"
@@ -42,6 +48,7 @@
 #include "position.h"
 #include "search.h"
 #include "thread.h"
+#include "syzygy/tbprobe.h"
 #include "book/book.h"
 
 namespace Hypnos {
@@ -89,6 +96,13 @@ void position(Position& pos, std::istringstream& is, StateListPtr& states) {
     static constexpr Key StartPosKey = 0xB4D30CD15A43432D;
     if (firstKey == StartPosKey && pos.game_ply() == 0)
         Experience::resume_learning();
+
+    // Warm up the tablebases in the background once one capture away from them
+    if (Options["SyzygyWarmup"] && pos.count<ALL_PIECES>() <= Tablebases::MaxCardinality + 1)
+        Tablebases::warm_up(pos, true, true);
+
+    // Look up the position and its children on the experience server in the background
+    Experience::prefetch(pos);
 }
 
 // Prints the evaluation of the current position,
@@ -176,6 +190,64 @@ void go(Position& pos, std::istringstream& is, StateListPtr& states) {
 }
 
 
+// Prints the search telemetry counters of every thread followed by their sum,
+// either as a plain table or as a single JSON object. Called by the "stats"
+// command and at the end of "bench". Example: stats json
+void stats(std::ostream& os, bool json) {
+
+    constexpr const char* Names[Search::STATS_COUNTER_NB] = {
+      "ttProbes",      "ttHits",       "expProbes",   "expHits",  "evalBig",      "evalSmall",
+      "evalPsqtOnly",  "accRefreshes", "accUpdates",  "nmpTries", "nmpCutoffs",   "lmrSearches",
+      "lmrResearches", "qsearchNodes", "betaCutoffs", "tbProbes", "tbCacheHits"};
+
+    uint64_t total[Search::STATS_COUNTER_NB] = {};
+
+    for (Thread* th : Threads)
+        for (int c = 0; c < Search::STATS_COUNTER_NB; ++c)
+            total[c] += th->stats.get(Search::StatsCounter(c));
+
+    auto print = [&](const std::string& name, auto counter) {
+        if (json)
+        {
+            os << "\"" << name << "\": {";
+            for (int c = 0; c < Search::STATS_COUNTER_NB; ++c)
+                os << (c ? ", \"" : "\"") << Names[c] << "\": " << counter(c);
+            os << "}";
+        }
+        else
+        {
+            os << "\n" << name;
+            for (int c = 0; c < Search::STATS_COUNTER_NB; ++c)
+                os << "\n  " << Names[c] << std::string(14 - std::strlen(Names[c]), ' ')
+                   << counter(c);
+        }
+    };
+
+    if (json)
+        os << "{";
+
+    for (Thread* th : Threads)
+    {
+        print("thread " + std::to_string(th->id()),
+              [&](int c) { return th->stats.get(Search::StatsCounter(c)); });
+        if (json)
+            os << ", ";
+    }
+
+    print("total", [&](int c) { return total[c]; });
+
+    // Share of tablebase probes answered by the shared probe cache
+    double tbHitRate = total[Search::TB_PROBES]
+                       ? 100.0 * total[Search::TB_CACHE_HITS] / total[Search::TB_PROBES]
+                       : 0.0;
+
+    if (json)
+        os << ", \"tbCacheHitRate\": " << tbHitRate << "}";
+    else
+        os << "\n\ntbCacheHitRate  " << tbHitRate << "%";
+}
+
+
 // Called when the engine receives the "bench" command.
 // First, a list of UCI commands is set up according to the bench
 // parameters, then it is run one by one, printing a summary at the end.
@@ -217,6 +289,7 @@ void bench(Position& pos, std::istream& args, StateListPtr& states) {
         else if (token == "ucinewgame")
         {
             Search::clear();
+            instrument_clear();
             elapsed = now();
         }  // Search::clear() may take a while
     }
@@ -224,10 +297,433 @@ void bench(Position& pos, std::istream& args, StateListPtr& states) {
     elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
 
     dbg_print();
+    instrument_print(nodes);
 
     std::cerr << "\n==========================="
               << "\nTotal time (ms) : " << elapsed << "\nNodes searched  : " << nodes
               << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
+
+    std::cerr << "\nSearch stats    : ";
+    stats(std::cerr, true);
+    std::cerr << std::endl;
+}
+
+// Called when the engine receives the "golatency" command. It runs a number of
+// 'go depth 1' searches on the current position and reports how long it takes
+// from 'go' until the main thread and the slowest helper thread enter their
+// iterative deepening loop, and how long each phase on the way takes: root move
+// generation and ranking, copying the root to the threads, waking up the main
+// thread and its checks before the search (net, books, experience).
+// Example: golatency 200
+void golatency(Position& pos, std::istream& args, StateListPtr& states) {
+
+    int runs = 100;
+    args >> runs;
+    runs = std::max(runs, 1);
+
+    constexpr int PhaseNb = 6;
+
+    const char* names[PhaseNb] = {"Root moves avg/max (us)    : ",
+                                  "Thread setup avg/max (us)  : ",
+                                  "Main wake-up avg/max (us)  : ",
+                                  "Main prelude avg/max (us)  : ",
+                                  "Main thread avg/max (us)   : ",
+                                  "Slowest helper avg/max (us): "};
+    int64_t     sum[PhaseNb] = {}, max[PhaseNb] = {};
+
+    for (int i = 0; i < runs; ++i)
+    {
+        std::istringstream is("depth 1");
+        go(pos, is, states);
+        Threads.main()->wait_for_search_finished();
+
+        int64_t slowest = 0;
+        for (Thread* th : Threads)
+            if (th != Threads.main())
+                slowest = std::max(slowest, th->startTime - Threads.goTime);
+
+        const int64_t phases[PhaseNb] = {Threads.rootMovesTime - Threads.goTime,
+                                         Threads.setupTime - Threads.rootMovesTime,
+                                         Threads.main()->wakeTime - Threads.setupTime,
+                                         Threads.main()->startTime - Threads.main()->wakeTime,
+                                         Threads.main()->startTime - Threads.goTime,
+                                         slowest};
+
+        for (int p = 0; p < PhaseNb; ++p)
+            sum[p] += phases[p], max[p] = std::max(max[p], phases[p]);
+    }
+
+    std::cerr << "\n==========================="
+              << "\nRuns                       : " << runs
+              << "\nThreads                    : " << Threads.size()
+              << "\nThread Spin Time (us)      : " << Threads.spinTime;
+
+    for (int p = 0; p < PhaseNb; ++p)
+        std::cerr << "\n" << names[p] << sum[p] / runs / 1000 << " / " << max[p] / 1000;
+
+    std::cerr << std::endl;
+}
+
+// Called when the engine receives the "clearlatency" command. It runs the
+// 'ucinewgame' clearing a number of times and reports the average time of each
+// phase. Example: clearlatency 10
+void clearlatency(std::istream& args) {
+
+    int runs = 10;
+    args >> runs;
+    runs = std::max(runs, 1);
+
+    Search::ClearTimes sum{};
+
+    for (int i = 0; i < runs; ++i)
+    {
+        Search::clear();
+        sum.tt += Search::LastClear.tt;
+        sum.histories += Search::LastClear.histories;
+        sum.tablebases += Search::LastClear.tablebases;
+        sum.experience += Search::LastClear.experience;
+    }
+
+    std::cerr << "\n==========================="
+              << "\nRuns                       : " << runs
+              << "\nThreads                    : " << Threads.size()
+              << "\nHash (MB)                  : " << Options["Hash"]
+              << "\nTT avg (us)                : " << sum.tt / runs / 1000
+              << "\nHistories avg (us)         : " << sum.histories / runs / 1000
+              << "\nTablebases avg (us)        : " << sum.tablebases / runs / 1000
+              << "\nExperience avg (us)        : " << sum.experience / runs / 1000 << std::endl;
+}
+
+// Perft without the perft hash, so that the time is spent in move generation
+uint64_t raw_perft(Position& pos, int depth) {
+
+    if (depth <= 1)
+        return legal_move_count(pos);
+
+    uint64_t  nodes = 0;
+    StateInfo st;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        pos.do_move(m, st);
+        nodes += raw_perft(pos, depth - 1);
+        pos.undo_move(m);
+    }
+
+    return nodes;
+}
+
+// Called when the engine receives the "slidercompare" command. It runs a perft
+// of the current position with each slider attack backend of this build and
+// reports the time taken by each, then restores the backend chosen at startup.
+// Example: slidercompare 5
+void slidercompare(Position& pos, std::istream& args) {
+
+    int depth = 5;
+    args >> depth;
+    depth = std::clamp(depth, 1, 8);
+
+    // The attack tables are rebuilt in place, nothing else may read them meanwhile
+    Threads.main()->wait_for_search_finished();
+    Tablebases::stop_warm_up();
+
+    constexpr const char* Names[SLIDER_BACKEND_NB] = {"PEXT", "Magic bitboards"};
+    const SliderBackend   chosen                   = Sliders;
+
+    std::cerr << "\n==========================="
+              << "\nDepth                      : " << depth;
+
+    for (SliderBackend b : {PextSliders, MagicSliders})
+    {
+        if (b == PextSliders && !HasPext)
+            continue;
+
+        Bitboards::set_sliders(b);
+
+        const int64_t  start = now_ns();
+        const uint64_t nodes = raw_perft(pos, depth);
+        const int64_t  ms    = std::max<int64_t>((now_ns() - start) / 1000000, 1);
+
+        std::cerr << "\n" << Names[b] << std::string(27 - std::strlen(Names[b]), ' ') << ": "
+                  << nodes << " nodes, " << ms << " ms, " << nodes / ms << " knps";
+    }
+
+    Bitboards::set_sliders(chosen);
+
+    std::cerr << "\nIn use                     : " << Bitboards::sliders_info() << std::endl;
+}
+
+// Called when the engine receives the "benchsuite" command. It runs the positions
+// of a named suite a number of times at a fixed depth and reports the mean,
+// standard deviation and median of the nodes/second over the repetitions, and
+// the nodes and time to depth of every position. With 'json' the results are
+// also written as JSON to the given file, or to stdout, for 'benchcompare'.
+// Example: benchsuite endgame reps 10 depth 16 threads 1 hash 64 json base.json
+void benchsuite(Position& pos, std::istream& args, StateListPtr& states) {
+
+    std::string suiteName = "middlegame", token, jsonFile;
+    int         reps = 5, depth = 13, threads = 1, hash = 16;
+    bool        json = false;
+
+    // The suite name is optional, any other first token names the suite
+    for (bool first = true; args >> token; first = false)
+        if (token == "reps")
+            args >> reps;
+        else if (token == "depth")
+            args >> depth;
+        else if (token == "threads")
+            args >> threads;
+        else if (token == "hash")
+            args >> hash;
+        else if (token == "json")
+            json = true, args >> jsonFile;
+        else if (first)
+            suiteName = token;
+
+    // A value that is not a number stops the parsing before the end
+    if (!args.eof())
+    {
+        sync_cout << "info string Invalid benchsuite arguments" << sync_endl;
+        return;
+    }
+
+    const BenchSuite* suite = bench_suite(suiteName);
+    if (!suite)
+    {
+        sync_cout << "info string Unknown bench suite " << suiteName
+                  << ", available suites: " << bench_suite_names() << sync_endl;
+        return;
+    }
+
+    reps  = std::max(reps, 1);
+    depth = std::max(depth, 1);
+
+    auto run = [&](const std::string& cmd) {
+        std::istringstream is(cmd);
+        is >> std::skipws >> token;
+
+        if (token == "setoption")
+            setoption(is);
+        else if (token == "position")
+            position(pos, is, states);
+    };
+
+    // The options changed by the suite or by the arguments are restored afterwards
+    const int  prevThreads     = int(Options["Threads"]);
+    const int  prevHash        = int(Options["Hash"]);
+    const bool prevExpEnabled  = bool(Options["Experience Enabled"]);
+    const bool prevExpReadonly = bool(Options["Experience Readonly"]);
+
+    for (const auto& cmd : suite->setup)
+        run(cmd);
+
+    run("setoption name Threads value " + std::to_string(threads));
+    run("setoption name Hash value " + std::to_string(hash));
+
+    // Report the values in use, out of range ones are not applied
+    threads = int(Options["Threads"]);
+    hash    = int(Options["Hash"]);
+
+    const size_t                     count = suite->fens.size();
+    std::vector<double>              nps;
+    std::vector<uint64_t>            posNodes(count);
+    std::vector<std::vector<double>> posTimes(count);
+
+    for (int r = 0; r < reps; ++r)
+    {
+        Search::clear();
+
+        uint64_t nodes = 0;
+        int64_t  time  = 0;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            // Bench lists may embed setoption commands, e.g. for Chess960
+            if (suite->fens[i].find("setoption") == 0)
+            {
+                run(suite->fens[i]);
+                continue;
+            }
+
+            run("position fen " + suite->fens[i]);
+
+            std::istringstream is("depth " + std::to_string(depth));
+            const int64_t      start = now_ns();
+            go(pos, is, states);
+            Threads.main()->wait_for_search_finished();
+            const int64_t elapsed = std::max<int64_t>(now_ns() - start, 1);
+
+            posNodes[i] = Threads.nodes_searched();
+            posTimes[i].push_back(elapsed / 1e6);
+            nodes += posNodes[i];
+            time += elapsed;
+        }
+
+        nps.push_back(nodes * 1e9 / std::max<int64_t>(time, 1));
+
+        std::cerr << "\nRepetition " << r + 1 << '/' << reps << ": " << nodes << " nodes, "
+                  << time / 1000000 << " ms, " << uint64_t(nps.back()) << " nodes/second"
+                  << std::endl;
+    }
+
+    for (const auto& cmd : suite->teardown)
+        run(cmd);
+
+    if (int(Options["Threads"]) != prevThreads)
+        run("setoption name Threads value " + std::to_string(prevThreads));
+
+    if (int(Options["Hash"]) != prevHash)
+        run("setoption name Hash value " + std::to_string(prevHash));
+
+    if (bool(Options["Experience Enabled"]) != prevExpEnabled)
+        run(std::string("setoption name Experience Enabled value ")
+            + (prevExpEnabled ? "true" : "false"));
+
+    if (bool(Options["Experience Readonly"]) != prevExpReadonly)
+        run(std::string("setoption name Experience Readonly value ")
+            + (prevExpReadonly ? "true" : "false"));
+
+    const SampleStats s = sample_stats(nps);
+
+    std::cerr << "\n==========================="
+              << "\nSuite           : " << suite->name << "\nRepetitions     : " << reps
+              << "\nDepth           : " << depth << "\nThreads         : " << threads
+              << "\nNodes/second    : mean " << uint64_t(s.mean) << ", stddev "
+              << uint64_t(s.stddev) << " (" << std::fixed << std::setprecision(2)
+              << 100 * s.stddev / std::max(s.mean, 1.0) << "%), median " << uint64_t(s.median)
+              << std::endl;
+
+    for (size_t i = 0, n = 1; i < count; ++i)
+        if (!posTimes[i].empty())
+            std::cerr << "Position " << std::setw(3) << n++ << "    : " << std::setw(10)
+                      << posNodes[i] << " nodes, " << std::setw(9)
+                      << sample_stats(posTimes[i]).median << " ms to depth " << depth
+                      << std::endl;
+
+    std::cerr.unsetf(std::ios::floatfield);
+
+    if (!json)
+        return;
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3) << "{\n  \"suite\": \"" << suite->name
+       << "\",\n  \"reps\": " << reps << ",\n  \"depth\": " << depth
+       << ",\n  \"threads\": " << threads << ",\n  \"hash\": " << hash << ",\n  \"nps\": {"
+       << "\"mean\": " << s.mean << ", \"stddev\": " << s.stddev << ", \"median\": " << s.median
+       << ",\n    \"samples\": [";
+
+    for (size_t r = 0; r < nps.size(); ++r)
+        ss << (r ? ", " : "") << nps[r];
+
+    ss << "]},\n  \"positions\": [";
+
+    for (size_t i = 0, n = 0; i < count; ++i)
+        if (!posTimes[i].empty())
+        {
+            const SampleStats t = sample_stats(posTimes[i]);
+            ss << (n++ ? "," : "") << "\n    {\"fen\": \"" << suite->fens[i]
+               << "\", \"nodes\": " << posNodes[i] << ", \"timeToDepthMs\": {\"mean\": " << t.mean
+               << ", \"median\": " << t.median << "}}";
+        }
+
+    ss << "\n  ]\n}\n";
+
+    if (jsonFile.empty())
+        sync_cout << ss.str() << sync_endl;
+    else if (std::ofstream(jsonFile) << ss.str())
+        sync_cout << "info string Bench results written to " << jsonFile << sync_endl;
+    else
+        sync_cout << "info string Could not write " << jsonFile << sync_endl;
+}
+
+// Reads the nodes/second samples and the per-position node counts back from a
+// JSON file written by 'benchsuite'. This is not a general JSON parser, and it
+// returns false on anything it cannot read, e.g. a truncated or edited file.
+bool read_bench_json(const std::string&     file,
+                     std::vector<double>&   nps,
+                     std::vector<uint64_t>& nodes) {
+
+    std::ifstream f(file);
+    if (!f)
+        return false;
+
+    std::string text((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    size_t      idx = text.find("\"samples\": [");
+    if (idx == std::string::npos)
+        return false;
+
+    const size_t end = text.find(']', idx);
+    if (end == std::string::npos)
+        return false;
+
+    // Each sample is a number followed only by blanks
+    std::istringstream samples(text.substr(idx + 12, end - idx - 12));
+    for (std::string value; std::getline(samples, value, ',');)
+    {
+        char*        last;
+        const double v = std::strtod(value.c_str(), &last);
+
+        if (last == value.c_str() || value.find_first_not_of(" \t\n", last - value.c_str())
+                                       != std::string::npos)
+            return false;
+
+        nps.push_back(v);
+    }
+
+    for (idx = text.find("\"nodes\": "); idx != std::string::npos;
+         idx = text.find("\"nodes\": ", idx + 1))
+    {
+        const char* first = text.c_str() + idx + 9;
+        uint64_t    n;
+
+        if (std::from_chars(first, text.c_str() + text.size(), n).ec != std::errc())
+            return false;
+
+        nodes.push_back(n);
+    }
+
+    return !nps.empty();
+}
+
+// Called when the engine receives the "benchcompare" command. It compares the
+// nodes/second of two 'benchsuite' JSON files with Welch's t-test and reports
+// whether the speed difference is significant at the 5% level, and whether the
+// searches visited the same number of nodes. Example: benchcompare base.json new.json
+void benchcompare(std::istream& args) {
+
+    std::string           base, test;
+    std::vector<double>   baseNps, testNps;
+    std::vector<uint64_t> baseNodes, testNodes;
+
+    args >> base >> test;
+
+    for (auto [file, nps, nodes] :
+         {std::tie(base, baseNps, baseNodes), std::tie(test, testNps, testNodes)})
+        if (!read_bench_json(file, nps, nodes))
+        {
+            sync_cout << "info string Could not read bench results from " << file << sync_endl;
+            return;
+        }
+
+    const SampleStats a = sample_stats(baseNps), b = sample_stats(testNps);
+    double            t;
+    const double      p = welch_p_value(a, b, &t);
+
+    size_t changed = baseNodes.size() != testNodes.size();
+    for (size_t i = 0; !changed && i < baseNodes.size(); ++i)
+        changed += baseNodes[i] != testNodes[i];
+
+    sync_cout << std::fixed << std::setprecision(2) << "Base            : " << base << ", nps mean "
+              << uint64_t(a.mean) << " +- " << uint64_t(a.stddev) << " (" << a.n << " runs)"
+              << "\nTest            : " << test << ", nps mean " << uint64_t(b.mean) << " +- "
+              << uint64_t(b.stddev) << " (" << b.n << " runs)"
+              << "\nSpeedup         : " << std::showpos << 100 * (b.mean - a.mean) / a.mean
+              << std::noshowpos << "%"
+              << "\nWelch t-test    : t = " << t << ", p = " << std::setprecision(4) << p
+              << (p < 0.05 ? " (significant at 5%)" : " (not significant at 5%)")
+              << "\nNodes searched  : " << (changed ? "different" : "identical") << sync_endl;
+
+    std::cout.unsetf(std::ios::floatfield);
 }
 
 // The win rate model returns the probability of winning (in per mille units) given an
@@ -283,14 +779,20 @@ void UCI::loop(int argc, char* argv[]) {
         is >> std::skipws >> token;
 
         if (token == "quit" || token == "stop")
+        {
             Threads.stop = true;
+            Threads.main()->notify_stop_or_ponderhit();
+        }
 
         // The GUI sends 'ponderhit' to tell that the user has played the expected move.
         // So, 'ponderhit' is sent if pondering was done on the same move that the user
         // has played. The search should continue, but should also switch from pondering
         // to the normal search.
         else if (token == "ponderhit")
+        {
             Threads.main()->ponder = false;  // Switch to the normal search
+            Threads.main()->notify_stop_or_ponderhit();
+        }
 
         else if (token == "uci")
             sync_cout << "id name " << engine_info(true) << "\n"
@@ -309,6 +811,10 @@ void UCI::loop(int argc, char* argv[]) {
             //Make sure experience has finished loading
             Experience::wait_for_loading_finished();
 
+            // Link the experience appended by other engines sharing the file
+            if (!Threads.main()->is_searching())
+                Experience::refresh();
+
             sync_cout << "readyok" << sync_endl;
         }
 
@@ -318,18 +824,52 @@ void UCI::loop(int argc, char* argv[]) {
             pos.flip();
         else if (token == "bench")
             bench(pos, is, states);
+        else if (token == "golatency")
+            golatency(pos, is, states);
+        else if (token == "clearlatency")
+            clearlatency(is);
+        else if (token == "slidercompare")
+            slidercompare(pos, is);
+        else if (token == "benchsuite")
+            benchsuite(pos, is, states);
+        else if (token == "benchcompare")
+            benchcompare(is);
+        else if (token == "stats")
+        {
+            std::string        format;
+            std::ostringstream ss;
+            is >> std::skipws >> format;
+            stats(ss, format == "json");
+            sync_cout << ss.str() << sync_endl;
+        }
         else if (token == "d")
             sync_cout << pos << sync_endl;
         else if (token == "eval")
             trace_eval(pos);
         else if (token == "book")
             Book::show_moves(pos);
+        else if (token == "bookbench")
+        {
+            size_t probes = 1000000;
+            is >> probes;
+            Book::benchmark(probes);
+        }
+        else if (token == "tbwarmup")
+        {
+            std::string touch;
+            is >> std::skipws >> touch;
+            Tablebases::warm_up(pos, touch == "touch", false);
+        }
+        else if (token == "compile_book")
+            Book::compile(pos, is);
         else if (token == "compiler")
             sync_cout << compiler_info() << sync_endl;
         else if (argc > 2 && token == "defrag")
             Experience::defrag(argc - 2, argv + 2);
         else if (argc > 2 && token == "merge")
             Experience::merge(argc - 2, argv + 2);
+        else if (argc > 2 && token == "expserver")
+            Experience::serve(argc - 2, argv + 2);
         else if (token == "exp")
             Experience::show_exp(pos, false);
         else if (token == "expex")
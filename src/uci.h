@@ -22,6 +22,7 @@
 #include <cstddef>
 #include <iosfwd>
 #include <map>
+#include <memory>
 #include <string>
 
 #include "types.h"
@@ -70,7 +71,32 @@ class Option {
     OnChange    on_change;
 };
 
+// Snapshot holds typed copies of the options read during a search. A new one
+// is published on every setoption, so that the search never parses option
+// strings or walks the options map, and a search running while an option
+// changes keeps reading consistent values. A snapshot is freed once it is
+// neither the current one nor held by a reader.
+struct Snapshot {
+    int  multiPV, skillLevel, elo;
+    bool multiPVSplit, limitStrength, showWDL, ponder;
+    int  minThinkingTime, moveOverhead, nodestime;
+    int  bookWidth, bookDepth;
+    bool syzygy50MoveRule;
+    int  syzygyProbeDepth, syzygyProbeLimit;
+    bool expReadonly, expBook;
+    int  expBookWidth, expBookEvalImportance, expBookMinDepth, expBookMaxMoves;
+    int  expPrefillPlies, expPrefillNodes, expCompaction;
+    int  variety, varietyMaxScore, varietyMaxMoves;
+};
+
+extern std::shared_ptr<const Snapshot> CurrentSnapshot;
+
+inline std::shared_ptr<const Snapshot> snapshot() {
+    return std::atomic_load_explicit(&CurrentSnapshot, std::memory_order_acquire);
+}
+
 void        init(OptionsMap&);
+void        publish_snapshot(const OptionsMap&);
 void        loop(int argc, char* argv[]);
 int         to_cp(Value v);
 std::string value(Value v);
@@ -23,6 +23,7 @@
 #include <iosfwd>
 #include <istream>
 #include <map>
+#include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
@@ -46,13 +47,17 @@ UCI::OptionsMap Options;  // Global object
 
 namespace UCI {
 
+std::shared_ptr<const Snapshot> CurrentSnapshot;
+
 // 'On change' actions, triggered by an option's value change
 static void on_clear_hash(const Option&) { Search::clear(); }
 static void on_hash_size(const Option& o) { TT.resize(size_t(o)); }
 static void on_logger(const Option& o) { start_logger(o); }
 static void on_threads(const Option& o) { Threads.set(size_t(o)); }
+static void on_thread_spin(const Option& o) { Threads.spinTime = int(o); }
 static void on_book(const Option& o) { Book::on_book((string) o); }
 static void on_tb_path(const Option& o) { Tablebases::init(o); }
+static void on_tb_cache(const Option& o) { Tablebases::resize_cache(size_t(o)); }
 static void on_exp_enabled(const Option& /*o*/) { Experience::init(); }
 static void on_exp_file(const Option& /*o*/) { Experience::init(); }
 static void on_eval_file(const Option&) { Eval::NNUE::init(); }
@@ -79,10 +84,12 @@ void init(OptionsMap& o) {
 
     o["Debug Log File"] << Option("", on_logger);
     o["Threads"] << Option(1, 1, 1024, on_threads);
+    o["Thread Spin Time"] << Option(0, 0, 100000, on_thread_spin);
     o["Hash"] << Option(16, 1, MaxHashMB, on_hash_size);
     o["Clear Hash"] << Option(on_clear_hash);
     o["Ponder"] << Option(false);
     o["MultiPV"] << Option(1, 1, 500);
+    o["MultiPV Split"] << Option(false);
     o["Skill Level"] << Option(20, 0, 20);
     o["MoveOverhead"] << Option(10, 0, 5000);
     o["Minimum Thinking Time"] << Option(100, 0, 5000);
@@ -94,18 +101,25 @@ void init(OptionsMap& o) {
     o["Book File"] << Option("<empty>", on_book);
     o["Book Width"] << Option(1, 1, 20);
     o["Book Depth"] << Option(255, 1, 255);
+    o["Book Preload"] << Option(false);
     o["SyzygyPath"] << Option("<empty>", on_tb_path);
     o["SyzygyProbeDepth"] << Option(1, 1, 100);
     o["Syzygy50MoveRule"] << Option(true);
     o["SyzygyProbeLimit"] << Option(7, 0, 7);
+    o["SyzygyCacheSize"] << Option(16, 0, 4096, on_tb_cache);
+    o["SyzygyWarmup"] << Option(false);
     o["Experience Enabled"] << Option(false, on_exp_enabled);
     o["Experience File"] << Option("Hypnos.exp", on_exp_file);
+    o["Experience Server"] << Option("<empty>", on_exp_file);
     o["Experience Readonly"] << Option(false);
     o["Experience Book"] << Option(false);
     o["Experience Book Width"] << Option(1, 1, 20);
     o["Experience Book Eval Importance"] << Option(5, 0, 10);
     o["Experience Book Min Depth"] << Option(27, Experience::MinDepth, 64);
     o["Experience Book Max Moves"] << Option(16, 1, 100);
+    o["Experience Prefill Plies"] << Option(0, 0, 64);
+    o["Experience Prefill Nodes"] << Option(100000, 1, 10000000);
+    o["Experience Compaction"] << Option(0, 0, 100);
     o["EvalFile"] << Option(EvalFileDefaultNameBig, on_eval_file);
     o["EvalFileSmall"] << Option(EvalFileDefaultNameSmall, on_eval_file);
     o["Variety"] << Option(0, 0, 40);
@@ -115,6 +129,47 @@ void init(OptionsMap& o) {
       << Option(0, -12, 12, on_materialistic_evaluation_strategy);
     o["Positional Evaluation Strategy"] 
 	  << Option(0, -12, 12, on_positional_evaluation_strategy);
+
+    publish_snapshot(o);
+}
+
+
+// Builds a snapshot of the current option values and makes it the one read by
+// the search. The previous one lives on while a running search still holds it.
+void publish_snapshot(const OptionsMap& o) {
+
+    auto s = std::make_shared<Snapshot>();
+
+    s->multiPV               = int(o.at("MultiPV"));
+    s->skillLevel            = int(o.at("Skill Level"));
+    s->elo                   = int(o.at("UCI_Elo"));
+    s->multiPVSplit          = bool(o.at("MultiPV Split"));
+    s->limitStrength         = bool(o.at("UCI_LimitStrength"));
+    s->showWDL               = bool(o.at("UCI_ShowWDL"));
+    s->ponder                = bool(o.at("Ponder"));
+    s->minThinkingTime       = int(o.at("Minimum Thinking Time"));
+    s->moveOverhead          = int(o.at("MoveOverhead"));
+    s->nodestime             = int(o.at("nodestime"));
+    s->bookWidth             = int(o.at("Book Width"));
+    s->bookDepth             = int(o.at("Book Depth"));
+    s->syzygy50MoveRule      = bool(o.at("Syzygy50MoveRule"));
+    s->syzygyProbeDepth      = int(o.at("SyzygyProbeDepth"));
+    s->syzygyProbeLimit      = int(o.at("SyzygyProbeLimit"));
+    s->expReadonly           = bool(o.at("Experience Readonly"));
+    s->expBook               = bool(o.at("Experience Book"));
+    s->expBookWidth          = int(o.at("Experience Book Width"));
+    s->expBookEvalImportance = int(o.at("Experience Book Eval Importance"));
+    s->expBookMinDepth       = int(o.at("Experience Book Min Depth"));
+    s->expBookMaxMoves       = int(o.at("Experience Book Max Moves"));
+    s->expPrefillPlies       = int(o.at("Experience Prefill Plies"));
+    s->expPrefillNodes       = int(o.at("Experience Prefill Nodes"));
+    s->expCompaction         = int(o.at("Experience Compaction"));
+    s->variety               = int(o.at("Variety"));
+    s->varietyMaxScore       = int(o.at("Variety Max Score"));
+    s->varietyMaxMoves       = int(o.at("Variety Max Moves"));
+
+    std::atomic_store_explicit(&CurrentSnapshot, std::shared_ptr<const Snapshot>(std::move(s)),
+                               std::memory_order_release);
 }
 
 
@@ -235,7 +290,10 @@ Option& Option::operator=(const string& v) {
     }
 
     if (type != "button")
+    {
         currentValue = v;
+        publish_snapshot(Options);  // Before on_change, which may read the snapshot
+    }
 
     if (on_change)
         on_change(*this);